@@ -5,3 +5,21 @@
 // or within the parser if you prefer. 
 //
 // However, some teams put definitions of ASTNode pure virtual destructors here.
+
+const char* nodeKindName(NodeKind kind) {
+    switch (kind) {
+    case NodeKind::Character: return "Character";
+    case NodeKind::Dot: return "Dot";
+    case NodeKind::Sequence: return "Sequence";
+    case NodeKind::Or: return "Or";
+    case NodeKind::Group: return "Group";
+    case NodeKind::Star: return "Star";
+    case NodeKind::Count: return "Count";
+    case NodeKind::IgnoreCase: return "IgnoreCase";
+    case NodeKind::OutputGroup: return "OutputGroup";
+    case NodeKind::Literal: return "Literal";
+    case NodeKind::CharClass: return "CharClass";
+    case NodeKind::DotStar: return "DotStar";
+    }
+    return "?";
+}
@@ -1,7 +1,9 @@
 #ifndef AST_H
 #define AST_H
 
+#include <bitset>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <cctype>
@@ -18,18 +20,56 @@ struct CaptureGroup {
     bool valid;
 };
 
+// Set of input bytes, e.g. the bytes a subpattern can start with.
+using ByteSet = std::bitset<256>;
+
+class MatchMemo;
+class MatchBudget;
+struct MatchStats;
+
 struct MatchContext {
-    const std::string& input;          // entire input
+    std::string_view input;            // entire input (or the part of a stream read so far)
     size_t position;                   // current matching position
     std::vector<std::optional<CaptureGroup>> captures; // store captures, group 0 = entire match if found
     bool ignoreCase;                   // global or local flag if case-insensitive
+    mutable bool hitEnd = false;       // set once matching looked at the end of input
+    MatchMemo* memo = nullptr;         // optional results table of the flat matcher (Memo.h)
+    MatchBudget* budget = nullptr;     // optional step / time limit, charged per node (Budget.h)
+    MatchStats* stats = nullptr;       // optional counters, see Stats.h
 
     // Helper to check if we are out of bounds
-    bool atEnd() const { return position >= input.size(); }
+    bool atEnd() const {
+        if (position < input.size()) return false;
+        hitEnd = true;
+        return true;
+    }
     // Helper to peek current character
     char currentChar() const { return atEnd() ? '\0' : input[position]; }
 };
 
+/**
+ * Tag for each concrete node type, so that later stages (compilation to a
+ * Program, analysis) can inspect the tree without dynamic_cast chains.
+ */
+enum class NodeKind {
+    Character,
+    Dot,
+    Sequence,
+    Or,
+    Group,
+    Star,
+    Count,
+    IgnoreCase,
+    OutputGroup,
+    // only produced by optimizePattern() (see Optimize.h)
+    Literal,
+    CharClass,
+    DotStar     // keep last, see kNodeKinds in Stats.h
+};
+
+// Name of a NodeKind, e.g. for statistics output.
+const char* nodeKindName(NodeKind kind);
+
 /**
  * Base class for all AST nodes. Each node must implement match() to attempt
  * matching from the current MatchContext::position forward.
@@ -45,6 +85,9 @@ public:
     // Returns true if match is successful (and moves context.position).
     // Returns false otherwise (and reverts changes to context).
     virtual bool match(MatchContext& ctx) = 0;
+
+    // Which concrete node this is (see NodeKind).
+    virtual NodeKind kind() const = 0;
 };
 
 /**
@@ -58,6 +101,11 @@ public:
  *  7) CountNode           - matches exactly N subpatterns
  *  8) IgnoreCaseNode      - sets ignore-case mode for subpattern
  *  9) OutputGroupNode     - signals which group index to output
+ *
+ * and, built from those by the optimizer:
+ * 10) LiteralNode         - matches a fixed string
+ * 11) CharClassNode       - matches one character out of a set
+ * 12) DotStarNode         - the same as a StarNode over a DotNode
  */
 
 #endif // AST_H
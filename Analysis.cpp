@@ -0,0 +1,319 @@
+#include "Analysis.h"
+#include "Fold.h"
+#include "Nodes.h"
+#include <algorithm>
+
+// What can come right after a subpattern inside the whole pattern:
+// a byte from 'first', or (if canEnd) nothing at all.
+struct Follow {
+    ByteSet first;
+    bool canEnd;
+};
+
+static ByteSet charSet(char c, bool foldCase) {
+    ByteSet s;
+    s.set((unsigned char)c);
+    if (foldCase) s.set(otherCase((unsigned char)c));
+    return s;
+}
+
+/**
+ * Every construct in here consumes at least one byte (the caller rejects
+ * {0} and empty groups first), so 'first' is well defined.
+ */
+static ByteSet firstSet(const std::shared_ptr<ASTNode>& node, bool foldCase) {
+    switch (node->kind()) {
+    case NodeKind::Character:
+        return charSet(std::static_pointer_cast<CharacterNode>(node)->getChar(), foldCase);
+    case NodeKind::Dot:
+        return ByteSet().set();
+    case NodeKind::Sequence:
+        return firstSet(std::static_pointer_cast<SequenceNode>(node)->getChildren().front(), foldCase);
+    case NodeKind::Or: {
+        auto alt = std::static_pointer_cast<OrNode>(node);
+        return firstSet(alt->getLeft(), foldCase) | firstSet(alt->getRight(), foldCase);
+    }
+    case NodeKind::Group:
+        return firstSet(std::static_pointer_cast<GroupNode>(node)->getExpr(), foldCase);
+    case NodeKind::Star:
+        return firstSet(std::static_pointer_cast<StarNode>(node)->getExpr(), foldCase);
+    case NodeKind::Count:
+        return firstSet(std::static_pointer_cast<CountNode>(node)->getExpr(), foldCase);
+    case NodeKind::IgnoreCase:
+        return firstSet(std::static_pointer_cast<IgnoreCaseNode>(node)->getExpr(), true);
+    case NodeKind::Literal: {
+        auto lit = std::static_pointer_cast<LiteralNode>(node);
+        return charSet(lit->getText()[0], foldCase || lit->getFoldCase());
+    }
+    case NodeKind::CharClass:
+        return std::static_pointer_cast<CharClassNode>(node)->getSet(foldCase);
+    case NodeKind::DotStar:
+        return ByteSet().set();
+    case NodeKind::OutputGroup:
+        break;
+    }
+    return ByteSet();
+}
+
+// Longer fixed lengths (from large {N}) count as varying, so products can't overflow.
+static const long kMaxFixedLength = 1L << 30;
+
+// Length of every string the subpattern matches, or -1 if it varies.
+static long fixedLength(const std::shared_ptr<ASTNode>& node) {
+    switch (node->kind()) {
+    case NodeKind::Character:
+    case NodeKind::Dot:
+    case NodeKind::CharClass:
+        return 1;
+    case NodeKind::Literal:
+        return (long)std::static_pointer_cast<LiteralNode>(node)->getText().size();
+    case NodeKind::Sequence: {
+        long total = 0;
+        for (auto& c : std::static_pointer_cast<SequenceNode>(node)->getChildren()) {
+            long n = fixedLength(c);
+            if (n < 0 || total + n > kMaxFixedLength) return -1;
+            total += n;
+        }
+        return total;
+    }
+    case NodeKind::Or: {
+        auto alt = std::static_pointer_cast<OrNode>(node);
+        long l = fixedLength(alt->getLeft());
+        return l == fixedLength(alt->getRight()) ? l : -1;
+    }
+    case NodeKind::Group:
+        return fixedLength(std::static_pointer_cast<GroupNode>(node)->getExpr());
+    case NodeKind::Star:
+    case NodeKind::DotStar:
+        return -1;
+    case NodeKind::Count: {
+        auto cnt = std::static_pointer_cast<CountNode>(node);
+        long n = fixedLength(cnt->getExpr());
+        if (n < 0 || (n > 0 && cnt->getCount() > kMaxFixedLength / n)) return -1;
+        return n * cnt->getCount();
+    }
+    case NodeKind::IgnoreCase:
+        return fixedLength(std::static_pointer_cast<IgnoreCaseNode>(node)->getExpr());
+    case NodeKind::OutputGroup:
+        break;
+    }
+    return -1;
+}
+
+// Rejects constructs that can match the empty string.
+static bool consumes(const std::shared_ptr<ASTNode>& node) {
+    if (!node) return false;
+    switch (node->kind()) {
+    case NodeKind::Character:
+    case NodeKind::Dot:
+    case NodeKind::CharClass:
+    case NodeKind::DotStar:
+        return true;
+    case NodeKind::Literal:
+        return !std::static_pointer_cast<LiteralNode>(node)->getText().empty();
+    case NodeKind::Sequence: {
+        auto& children = std::static_pointer_cast<SequenceNode>(node)->getChildren();
+        if (children.empty()) return false;
+        for (auto& c : children) {
+            if (!consumes(c)) return false;
+        }
+        return true;
+    }
+    case NodeKind::Or: {
+        auto alt = std::static_pointer_cast<OrNode>(node);
+        return consumes(alt->getLeft()) && consumes(alt->getRight());
+    }
+    case NodeKind::Group:
+        return consumes(std::static_pointer_cast<GroupNode>(node)->getExpr());
+    case NodeKind::Star:
+        return consumes(std::static_pointer_cast<StarNode>(node)->getExpr());
+    case NodeKind::Count: {
+        auto cnt = std::static_pointer_cast<CountNode>(node);
+        return cnt->getCount() > 0 && consumes(cnt->getExpr());
+    }
+    case NodeKind::IgnoreCase:
+        return consumes(std::static_pointer_cast<IgnoreCaseNode>(node)->getExpr());
+    case NodeKind::OutputGroup:
+        break;
+    }
+    return false;
+}
+
+/**
+ * Checks that, followed by something described by 'follow', the node's
+ * committed choices can never lose a match the Program would find.
+ */
+static bool deterministic(const std::shared_ptr<ASTNode>& node, bool foldCase, const Follow& follow) {
+    switch (node->kind()) {
+    case NodeKind::Character:
+    case NodeKind::Dot:
+    case NodeKind::Literal:
+    case NodeKind::CharClass:
+        return true;
+    case NodeKind::DotStar:
+        // a Star over '.': nothing may follow it but the end
+        return follow.first.none();
+    case NodeKind::Sequence: {
+        auto& children = std::static_pointer_cast<SequenceNode>(node)->getChildren();
+        for (size_t i = 0; i + 1 < children.size(); i++) {
+            Follow next{firstSet(children[i + 1], foldCase), false};
+            if (!deterministic(children[i], foldCase, next)) return false;
+        }
+        return deterministic(children.back(), foldCase, follow);
+    }
+    case NodeKind::Or: {
+        auto alt = std::static_pointer_cast<OrNode>(node);
+        if (!deterministic(alt->getLeft(), foldCase, follow)) return false;
+        if (!deterministic(alt->getRight(), foldCase, follow)) return false;
+        // either at most one branch can start at any position...
+        if ((firstSet(alt->getLeft(), foldCase) & firstSet(alt->getRight(), foldCase)).none()) {
+            return true;
+        }
+        // ...or both end at the same place when they succeed
+        long l = fixedLength(alt->getLeft());
+        return l >= 0 && l == fixedLength(alt->getRight());
+    }
+    case NodeKind::Group:
+        return deterministic(std::static_pointer_cast<GroupNode>(node)->getExpr(), foldCase, follow);
+    case NodeKind::Star: {
+        auto expr = std::static_pointer_cast<StarNode>(node)->getExpr();
+        ByteSet first = firstSet(expr, foldCase);
+        // what follows the loop must not look like another iteration
+        if ((first & follow.first).any()) return false;
+        return deterministic(expr, foldCase, Follow{first | follow.first, follow.canEnd});
+    }
+    case NodeKind::Count: {
+        auto cnt = std::static_pointer_cast<CountNode>(node);
+        if (cnt->getCount() == 1) return deterministic(cnt->getExpr(), foldCase, follow);
+        // inner copies are followed by the next copy, the last one by 'follow'
+        ByteSet first = firstSet(cnt->getExpr(), foldCase);
+        return deterministic(cnt->getExpr(), foldCase, Follow{first | follow.first, follow.canEnd});
+    }
+    case NodeKind::IgnoreCase:
+        return deterministic(std::static_pointer_cast<IgnoreCaseNode>(node)->getExpr(), true, follow);
+    case NodeKind::OutputGroup:
+        break;
+    }
+    return false;
+}
+
+bool isDeterministic(const std::shared_ptr<ASTNode>& ast) {
+    if (!consumes(ast)) return false;
+    return deterministic(ast, false, Follow{ByteSet(), true});
+}
+
+// Literal facts about a subpattern, combined bottom-up.
+struct LiteralInfo {
+    bool complete = true;   // the subpattern matches exactly 'prefix'
+    Literal prefix;         // every match starts with this
+    Literal suffix;         // every match ends with this
+    Literal inner;          // longest literal inside every match
+};
+
+// Keeps the bigger repetition counts from producing huge literals.
+static const int kMaxLiteralRepeat = 64;
+
+static Literal concat(const Literal& a, const Literal& b) {
+    if (a.text.empty()) return b;
+    if (b.text.empty()) return a;
+    return Literal{a.text + b.text, a.foldCase || b.foldCase};
+}
+
+static const Literal& longer(const Literal& a, const Literal& b) {
+    return b.text.size() > a.text.size() ? b : a;
+}
+
+static LiteralInfo sequenceInfo(const LiteralInfo& a, const LiteralInfo& b) {
+    LiteralInfo r;
+    r.complete = a.complete && b.complete;
+    r.prefix = a.complete ? concat(a.prefix, b.prefix) : a.prefix;
+    r.suffix = b.complete ? concat(a.suffix, b.suffix) : b.suffix;
+    r.inner = longer(longer(a.inner, b.inner), concat(a.suffix, b.prefix));
+    if (r.complete) r.inner = r.prefix;
+    return r;
+}
+
+static LiteralInfo literalInfo(const std::shared_ptr<ASTNode>& node, bool foldCase) {
+    LiteralInfo r;
+    // "()" matches the empty string as far as literals are concerned
+    if (!node) return r;
+
+    switch (node->kind()) {
+    case NodeKind::Character: {
+        Literal lit{std::string(1, std::static_pointer_cast<CharacterNode>(node)->getChar()), foldCase};
+        r.prefix = r.suffix = r.inner = lit;
+        break;
+    }
+    case NodeKind::Literal: {
+        auto lit = std::static_pointer_cast<LiteralNode>(node);
+        r.prefix = r.suffix = r.inner = Literal{lit->getText(), foldCase || lit->getFoldCase()};
+        break;
+    }
+    case NodeKind::Dot:
+    case NodeKind::CharClass:
+    case NodeKind::DotStar:
+        r.complete = false;
+        break;
+    case NodeKind::Sequence:
+        for (auto& c : std::static_pointer_cast<SequenceNode>(node)->getChildren()) {
+            r = sequenceInfo(r, literalInfo(c, foldCase));
+        }
+        break;
+    case NodeKind::Or: {
+        // only a shared prefix/suffix survives an alternation
+        auto alt = std::static_pointer_cast<OrNode>(node);
+        LiteralInfo l = literalInfo(alt->getLeft(), foldCase);
+        LiteralInfo rr = literalInfo(alt->getRight(), foldCase);
+        r.complete = false;
+        if (l.prefix.foldCase == rr.prefix.foldCase) {
+            size_t n = 0;
+            while (n < l.prefix.text.size() && n < rr.prefix.text.size()
+                   && l.prefix.text[n] == rr.prefix.text[n]) n++;
+            r.prefix = Literal{l.prefix.text.substr(0, n), l.prefix.foldCase};
+        }
+        if (l.suffix.foldCase == rr.suffix.foldCase) {
+            const std::string& a = l.suffix.text;
+            const std::string& b = rr.suffix.text;
+            size_t n = 0;
+            while (n < a.size() && n < b.size() && a[a.size() - 1 - n] == b[b.size() - 1 - n]) n++;
+            r.suffix = Literal{a.substr(a.size() - n), l.suffix.foldCase};
+        }
+        r.inner = longer(r.prefix, r.suffix);
+        break;
+    }
+    case NodeKind::Group:
+        return literalInfo(std::static_pointer_cast<GroupNode>(node)->getExpr(), foldCase);
+    case NodeKind::Star:
+        // one or more: the facts of a single iteration still hold
+        r = literalInfo(std::static_pointer_cast<StarNode>(node)->getExpr(), foldCase);
+        r.complete = false;
+        break;
+    case NodeKind::Count: {
+        auto cnt = std::static_pointer_cast<CountNode>(node);
+        LiteralInfo once = literalInfo(cnt->getExpr(), foldCase);
+        int reps = std::min(cnt->getCount(), kMaxLiteralRepeat);
+        for (int i = 0; i < reps; i++) {
+            r = sequenceInfo(r, once);
+        }
+        if (cnt->getCount() > reps) r.complete = false;
+        break;
+    }
+    case NodeKind::IgnoreCase:
+        return literalInfo(std::static_pointer_cast<IgnoreCaseNode>(node)->getExpr(), true);
+    case NodeKind::OutputGroup:
+        break;
+    }
+    return r;
+}
+
+Literal requiredPrefix(const std::shared_ptr<ASTNode>& ast) {
+    return literalInfo(ast, false).prefix;
+}
+
+Literal requiredSuffix(const std::shared_ptr<ASTNode>& ast) {
+    return literalInfo(ast, false).suffix;
+}
+
+Literal requiredLiteral(const std::shared_ptr<ASTNode>& ast) {
+    return literalInfo(ast, false).inner;
+}
@@ -0,0 +1,49 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <memory>
+#include <string>
+#include "AST.h"
+
+/**
+ * Static analysis passes over a parsed AST.
+ */
+
+/**
+ * isDeterministic
+ *  The tree matcher in Nodes.h commits to the first branch of '+' that
+ *  succeeds and lets '*' consume as much as it can, never giving back.
+ *  For many patterns this makes no difference: when alternatives start
+ *  with different bytes (or have the same fixed length), and when what
+ *  follows a '*' can't start like the starred subpattern, the tree matcher
+ *  succeeds at a position exactly when the Program (see Program.h) has a
+ *  match there, and it ends where the longest Program match ends.
+ *
+ *  Returns true if the whole pattern has that property, so an automaton
+ *  result can be used directly instead of being confirmed by the tree.
+ *  Conservative: patterns with {0} or an empty group are never reported.
+ *  CompiledPattern also requires Program::exact, which a very large {N}
+ *  clears (Program.h).
+ */
+bool isDeterministic(const std::shared_ptr<ASTNode>& ast);
+
+/**
+ * A literal string every match must contain. With foldCase it has to be
+ * compared ignoring case; since that can only find more candidates, a
+ * literal mixing exact and case-insensitive parts is simply marked foldCase.
+ */
+struct Literal {
+    std::string text;
+    bool foldCase = false;
+};
+
+// Literal every match starts with (empty if there is none).
+Literal requiredPrefix(const std::shared_ptr<ASTNode>& ast);
+
+// Literal every match ends with (empty if there is none).
+Literal requiredSuffix(const std::shared_ptr<ASTNode>& ast);
+
+// Longest literal found in every match, anywhere inside it (may be empty).
+Literal requiredLiteral(const std::shared_ptr<ASTNode>& ast);
+
+#endif // ANALYSIS_H
@@ -0,0 +1,342 @@
+#include "Arena.h"
+#include "Budget.h"
+#include "Compiler.h"
+#include "Fold.h"
+#include "Nodes.h"
+#include "Stats.h"
+
+static int32_t add(NodeArena& arena, NodeKind kind, int32_t a = -1, int32_t b = 0) {
+    arena.nodes.push_back(FlatNode{kind, false, 0, a, b, -1});
+    return (int32_t)arena.nodes.size() - 1;
+}
+
+// \I is settled here: a folded Character holds the lowered byte, and only letters keep the flag.
+static int32_t addChar(NodeArena& arena, unsigned char ch, bool foldCase) {
+    int32_t i = add(arena, NodeKind::Character);
+    arena.nodes[i].ch = foldCase ? foldLower(ch) : ch;
+    arena.nodes[i].foldCase = foldCase && hasOtherCase(ch);
+    return i;
+}
+
+// Returns the index of the flattened node, -1 for a missing subexpression.
+static int32_t flattenNode(NodeArena& arena, const std::shared_ptr<ASTNode>& node, bool foldCase) {
+    if (!node) return -1;
+
+    switch (node->kind()) {
+    case NodeKind::Character: {
+        return addChar(arena, (unsigned char)std::static_pointer_cast<CharacterNode>(node)->getChar(), foldCase);
+    }
+    case NodeKind::Dot:
+        return add(arena, NodeKind::Dot);
+    case NodeKind::DotStar:
+        return add(arena, NodeKind::DotStar);
+    case NodeKind::Literal: {
+        auto lit = std::static_pointer_cast<LiteralNode>(node);
+        if (lit->getText().size() == 1) {
+            // a Character is matched inline by its parent
+            return addChar(arena, (unsigned char)lit->getText()[0], foldCase || lit->getFoldCase());
+        }
+        bool fold = foldCase || lit->getFoldCase();
+        int32_t i = add(arena, NodeKind::Literal, (int32_t)arena.text.size(), (int32_t)lit->getText().size());
+        for (char c : lit->getText()) {
+            arena.text += fold ? (char)foldLower((unsigned char)c) : c;
+        }
+        arena.nodes[i].foldCase = fold;
+        return i;
+    }
+    case NodeKind::CharClass: {
+        arena.classes.push_back(std::static_pointer_cast<CharClassNode>(node)->getSet(foldCase));
+        return add(arena, NodeKind::CharClass, (int32_t)arena.classes.size() - 1);
+    }
+    case NodeKind::Sequence: {
+        auto& kids = std::static_pointer_cast<SequenceNode>(node)->getChildren();
+        std::vector<int32_t> flat;
+        flat.reserve(kids.size());
+        for (auto& c : kids) {
+            flat.push_back(flattenNode(arena, c, foldCase));
+        }
+        int32_t first = (int32_t)arena.children.size();
+        arena.children.insert(arena.children.end(), flat.begin(), flat.end());
+        return add(arena, NodeKind::Sequence, first, (int32_t)flat.size());
+    }
+    case NodeKind::Or: {
+        auto alt = std::static_pointer_cast<OrNode>(node);
+        int32_t l = flattenNode(arena, alt->getLeft(), foldCase);
+        int32_t r = flattenNode(arena, alt->getRight(), foldCase);
+        return add(arena, NodeKind::Or, l, r);
+    }
+    case NodeKind::Group: {
+        auto g = std::static_pointer_cast<GroupNode>(node);
+        int32_t e = flattenNode(arena, g->getExpr(), foldCase);
+        return add(arena, NodeKind::Group, e, g->getGroupIndex());
+    }
+    case NodeKind::Star: {
+        int32_t e = flattenNode(arena, std::static_pointer_cast<StarNode>(node)->getExpr(), foldCase);
+        return add(arena, NodeKind::Star, e);
+    }
+    case NodeKind::Count: {
+        auto cnt = std::static_pointer_cast<CountNode>(node);
+        int32_t e = flattenNode(arena, cnt->getExpr(), foldCase);
+        return add(arena, NodeKind::Count, e, cnt->getCount());
+    }
+    case NodeKind::IgnoreCase:
+        return flattenNode(arena, std::static_pointer_cast<IgnoreCaseNode>(node)->getExpr(), true);
+    case NodeKind::OutputGroup:
+        // a marker only, matches without consuming anything
+        return -1;
+    }
+    return -1;
+}
+
+/**
+ * Gives a memo slot to every Sequence/Or/Star/Count node whose subtree has
+ * no Group (a memoized result can't replay captures) but does have a Star.
+ * Children come before their parents, so one forward pass sees the subtree
+ * of each node already summarized.
+ */
+static void assignMemoSlots(NodeArena& arena) {
+    std::vector<char> hasGroup(arena.nodes.size(), 0);
+    std::vector<char> hasStar(arena.nodes.size(), 0);
+    auto from = [&](int32_t child, size_t parent) {
+        if (child < 0) return;
+        hasGroup[parent] |= hasGroup[child];
+        hasStar[parent] |= hasStar[child];
+    };
+
+    for (size_t i = 0; i < arena.nodes.size(); i++) {
+        FlatNode& node = arena.nodes[i];
+        switch (node.kind) {
+        case NodeKind::Sequence:
+            for (int32_t k = 0; k < node.b; k++) from(arena.children[node.a + k], i);
+            break;
+        case NodeKind::Or:
+            from(node.a, i);
+            from(node.b, i);
+            break;
+        case NodeKind::Group:
+            from(node.a, i);
+            hasGroup[i] = 1;
+            break;
+        case NodeKind::Star:
+            from(node.a, i);
+            hasStar[i] = 1;
+            break;
+        case NodeKind::Count:
+            from(node.a, i);
+            break;
+        default:
+            continue;
+        }
+        if (node.kind != NodeKind::Group && hasStar[i] && !hasGroup[i]) {
+            node.memo = arena.memoSlots++;
+        }
+    }
+}
+
+NodeArena flatten(const std::shared_ptr<ASTNode>& ast) {
+    NodeArena arena;
+    arena.root = flattenNode(arena, ast, false);
+    assignMemoSlots(arena);
+    return arena;
+}
+
+// Out of line, so the common, unmemoized path of matchNode() stays small.
+COLD_PATH static bool matchMemoized(const NodeArena& arena, int32_t index, MatchContext& ctx);
+static bool matchNode(const NodeArena& arena, int32_t index, MatchContext& ctx, bool memoize = true);
+
+// Only when the MatchContext didn't come with a slot for every group.
+COLD_PATH static void growCaptures(MatchContext& ctx, size_t count) {
+    ctx.captures.resize(count, std::nullopt);
+}
+
+static inline bool matchChar(const FlatNode& node, MatchContext& ctx) {
+    if (ctx.atEnd()) return false;
+    unsigned char inputChar = (unsigned char)ctx.input[ctx.position];
+    bool ok = (node.foldCase ? foldLower(inputChar) : inputChar) == node.ch;
+    if (ok) ctx.position++;
+    return ok;
+}
+
+static inline bool matchClass(const NodeArena& arena, const FlatNode& node, MatchContext& ctx) {
+    if (ctx.atEnd()) return false;
+    if (!arena.classes[node.a][(unsigned char)ctx.input[ctx.position]]) return false;
+    ctx.position++;
+    return true;
+}
+
+// Characters and classes (the most common children) are matched in place, without a call.
+static inline bool matchChild(const NodeArena& arena, int32_t index, MatchContext& ctx) {
+    if (index >= 0) {
+        const FlatNode& node = arena.nodes[index];
+        if (node.kind == NodeKind::Character || node.kind == NodeKind::CharClass) {
+            MATCH_STATS(if (ctx.stats) ctx.stats->nodeCalls[(int)node.kind]++);
+            return node.kind == NodeKind::Character ? matchChar(node, ctx) : matchClass(arena, node, ctx);
+        }
+    }
+    return matchNode(arena, index, ctx);
+}
+
+/**
+ * The cases mirror the match() implementations in Nodes.h one to one.
+ * Nodes with a memo slot go through matchMemoized() first, which comes back
+ * here with memoize = false to evaluate them.
+ */
+static bool matchNode(const NodeArena& arena, int32_t index, MatchContext& ctx, bool memoize) {
+    if (index < 0) return true;
+    // over budget: fail everything, the caller discards the result
+    if (ctx.budget && !ctx.budget->charge()) return false;
+    const FlatNode& node = arena.nodes[index];
+    if (memoize && node.memo >= 0 && ctx.memo) return matchMemoized(arena, index, ctx);
+    MATCH_STATS(if (ctx.stats) ctx.stats->nodeCalls[(int)node.kind]++);
+
+    switch (node.kind) {
+    case NodeKind::Character:
+        return matchChar(node, ctx);
+    case NodeKind::Dot:
+        if (ctx.atEnd()) return false;
+        ctx.position++;
+        return true;
+    case NodeKind::Literal:
+        return LiteralNode::matchText(ctx, arena.text.data() + node.a, node.b, node.foldCase);
+    case NodeKind::CharClass:
+        return matchClass(arena, node, ctx);
+    case NodeKind::DotStar:
+        if (ctx.atEnd()) return false;
+        ctx.position = ctx.input.size();
+        ctx.hitEnd = true;
+        return true;
+    case NodeKind::Sequence: {
+        size_t savedPos = ctx.position;
+        const int32_t* kids = arena.children.data() + node.a;
+        for (int32_t i = 0; i < node.b; i++) {
+            if (!matchChild(arena, kids[i], ctx)) {
+                MATCH_STATS(if (ctx.stats && i > 0) ctx.stats->backtracks++);
+                ctx.position = savedPos;
+                return false;
+            }
+        }
+        return true;
+    }
+    case NodeKind::Or: {
+        size_t savedPos = ctx.position;
+        if (matchChild(arena, node.a, ctx)) return true;
+        MATCH_STATS(if (ctx.stats) ctx.stats->backtracks++);
+        ctx.position = savedPos;
+        return matchChild(arena, node.b, ctx);
+    }
+    case NodeKind::Group: {
+        size_t startPos = ctx.position;
+        if (!matchChild(arena, node.a, ctx)) return false;
+        if (node.b >= 0) {
+            if (node.b >= (int)ctx.captures.size()) {
+                growCaptures(ctx, node.b + 1);
+            }
+            ctx.captures[node.b] = CaptureGroup{startPos, ctx.position, true};
+        }
+        return true;
+    }
+    case NodeKind::Star: {
+        int count = 0;
+        while (true) {
+            size_t savedPos = ctx.position;
+            if (!matchChild(arena, node.a, ctx)) {
+                ctx.position = savedPos;
+                break;
+            }
+            count++;
+            // an iteration that consumed nothing would repeat forever
+            if (ctx.position == savedPos) break;
+        }
+        return count >= 1;
+    }
+    case NodeKind::Count: {
+        size_t savedPos = ctx.position;
+        for (int32_t i = 0; i < node.b; i++) {
+            if (!matchChild(arena, node.a, ctx)) {
+                MATCH_STATS(if (ctx.stats && i > 0) ctx.stats->backtracks++);
+                ctx.position = savedPos;
+                return false;
+            }
+        }
+        return true;
+    }
+    case NodeKind::IgnoreCase:
+    case NodeKind::OutputGroup:
+        // never stored in an arena
+        break;
+    }
+    return true;
+}
+
+/**
+ * A memoized Star, in its recursive form: if its child matches at p and ends
+ * at q != p, the Star's result at p is the one at q (or just q if the Star
+ * fails there). So the loop walks forward until it fails, stops making
+ * progress or reaches a position already known, and every position on the
+ * way ends where that one does.
+ */
+static bool matchStarMemo(const NodeArena& arena, const FlatNode& node, MatchContext& ctx) {
+    MatchMemo& memo = *ctx.memo;
+    std::vector<size_t>& path = memo.path();
+    size_t bottom = path.size(); // nested Stars use the stack above this
+    size_t start = ctx.position;
+    size_t end = std::string::npos;
+    bool ok = false; // at least one iteration at start
+
+    while (true) {
+        size_t pos = ctx.position;
+        size_t known;
+        if (memo.lookup(node.memo, pos, known)) {
+            MATCH_STATS(if (ctx.stats) ctx.stats->memoHits++);
+            if (pos == start) ok = known != std::string::npos;
+            end = known == std::string::npos ? pos : known;
+            break;
+        }
+        if (!matchChild(arena, node.a, ctx)) {
+            ctx.position = pos;
+            memo.store(node.memo, pos, std::string::npos);
+            end = pos;
+            break;
+        }
+        path.push_back(pos);
+        ok = true;
+        // an iteration that consumed nothing would repeat forever
+        if (ctx.position == pos) {
+            end = pos;
+            break;
+        }
+    }
+
+    for (size_t i = bottom; i < path.size(); i++) {
+        memo.store(node.memo, path[i], end);
+    }
+    path.resize(bottom);
+
+    if (!ok) {
+        ctx.position = start;
+        return false;
+    }
+    ctx.position = end;
+    return true;
+}
+
+static bool matchMemoized(const NodeArena& arena, int32_t index, MatchContext& ctx) {
+    const FlatNode& node = arena.nodes[index];
+    if (node.kind == NodeKind::Star) return matchStarMemo(arena, node, ctx);
+
+    size_t start = ctx.position;
+    size_t end;
+    if (ctx.memo->lookup(node.memo, start, end)) {
+        MATCH_STATS(if (ctx.stats) ctx.stats->memoHits++);
+        if (end == std::string::npos) return false;
+        ctx.position = end;
+        return true;
+    }
+    bool ok = matchNode(arena, index, ctx, false);
+    ctx.memo->store(node.memo, start, ok ? ctx.position : std::string::npos);
+    return ok;
+}
+
+bool matchFlat(const NodeArena& arena, MatchContext& ctx) {
+    return matchNode(arena, arena.root, ctx);
+}
@@ -0,0 +1,53 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AST.h"
+#include "Memo.h"
+
+/**
+ * A compact copy of the AST: every node lives in one contiguous vector and
+ * refers to its children by index, so matching needs no virtual calls, no
+ * shared_ptr refcounting and far less pointer chasing.
+ *
+ * IgnoreCaseNode disappears in the flat form: its effect is resolved while
+ * flattening and stored as foldCase on the characters below it.
+ *
+ * Repetitions and alternations without capture groups below them (and with
+ * a Star somewhere below, anything else is cheap to redo) get a slot in the
+ * MatchMemo, used when the MatchContext has one.
+ */
+struct FlatNode {
+    NodeKind kind;
+    bool foldCase;      // Character/Literal: compare ignoring case
+    unsigned char ch;   // Character
+    int32_t a;          // Or: lhs; Group/Star/Count: child; Sequence: first slot in NodeArena::children;
+                        // Literal: offset in NodeArena::text; CharClass: index in NodeArena::classes
+    int32_t b;          // Or: rhs; Sequence: number of children; Group: group index; Count: repetitions;
+                        // Literal: length
+    int32_t memo;       // slot in the MatchMemo, -1 if not memoized
+};
+
+struct NodeArena {
+    std::vector<FlatNode> nodes;    // children come before their parents
+    std::vector<int32_t> children;  // child lists of Sequence nodes
+    std::string text;               // characters of Literal nodes
+    std::vector<ByteSet> classes;   // sets of CharClass nodes
+    int32_t root = -1;              // -1: matches the empty string
+    int32_t memoSlots = 0;          // number of memoized nodes
+};
+
+// Build the flat form of an AST produced by parsePattern().
+NodeArena flatten(const std::shared_ptr<ASTNode>& ast);
+
+/**
+ * Match the flat AST at ctx.position, with exactly the semantics of
+ * ASTNode::match() on the tree it was flattened from.
+ * If ctx.budget runs out the result is meaningless (see MatchBudget).
+ */
+bool matchFlat(const NodeArena& arena, MatchContext& ctx);
+
+#endif // ARENA_H
@@ -0,0 +1,38 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string_view>
+#include <vector>
+
+/**
+ * RecordBatch
+ *  - many short records matched in one call (CompiledPattern::matchesBatch()),
+ *    stored as arrays rather than one object per record: a buffer all of
+ *    them are in, and the offset and length of each record in it.
+ *  - records are in increasing order of offset and don't overlap; there may
+ *    be bytes between them (e.g. the delimiters of the lines of a mapped
+ *    file), so a batch can point into the input without copying it.
+ *  - clear() keeps the memory of the arrays, so refilling a batch for the
+ *    next part of the input doesn't allocate.
+ */
+struct RecordBatch {
+    std::string_view data;
+    std::vector<size_t> offsets;
+    std::vector<size_t> lengths;
+
+    size_t size() const { return offsets.size(); }
+    std::string_view record(size_t k) const { return std::string_view(data.data() + offsets[k], lengths[k]); }
+
+    // Adds data[offset, offset + length) after the last record.
+    void add(size_t offset, size_t length) {
+        offsets.push_back(offset);
+        lengths.push_back(length);
+    }
+
+    void clear() {
+        offsets.clear();
+        lengths.clear();
+    }
+};
+
+#endif // BATCH_H
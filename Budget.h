@@ -0,0 +1,76 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Limits for one search, for patterns that can't be trusted.
+ *  - maxSteps: node evaluations of the tree matcher, candidate starts tried
+ *    and bytes stepped through by the automata (LazyDFA, ShiftAnd), which
+ *    are charged MatchBudget::kScanBlock at a time (0 = no limit).
+ *  - timeout: wall-clock time from the start of the search (0 = none).
+ */
+struct MatchLimits {
+    uint64_t maxSteps = 0;
+    std::chrono::milliseconds timeout{0};
+};
+
+/**
+ * MatchBudget
+ *  - counts the work of one search against its MatchLimits; charge() says
+ *    whether the search may go on. Once it returns false it keeps doing so
+ *    and exceeded() tells the caller the answer is not to be trusted.
+ *  - the clock is only read every kClockInterval steps.
+ *  - a scan of an automaton calls charge(kScanBlock) after every
+ *    kScanBlock bytes; one that is stopped answers "no match".
+ */
+class MatchBudget {
+public:
+    static constexpr uint64_t kScanBlock = 4096;
+
+    void setLimits(const MatchLimits& l) { limits = l; }
+    const MatchLimits& getLimits() const { return limits; }
+
+    // Called at the start of every search.
+    void start() {
+        steps = 0;
+        over = false;
+        limited = limits.maxSteps > 0 || limits.timeout.count() > 0;
+        stepLimit = limits.maxSteps > 0 ? limits.maxSteps : UINT64_MAX;
+        if (limits.timeout.count() > 0) {
+            deadline = std::chrono::steady_clock::now() + limits.timeout;
+        }
+    }
+
+    bool charge(uint64_t count = 1) {
+        if (!limited) return true;
+        if (over) return false;
+        uint64_t before = steps;
+        steps += count;
+        if (steps > stepLimit ||
+            (limits.timeout.count() > 0 && steps / kClockInterval != before / kClockInterval &&
+             std::chrono::steady_clock::now() >= deadline)) {
+            over = true;
+        }
+        return !over;
+    }
+
+    bool exceeded() const { return over; }
+    // Whether there are limits at all (otherwise charge() always says yes).
+    bool active() const { return limited; }
+    // For searches split into parts, when one of the parts ran over.
+    void setExceeded() { over = true; }
+
+private:
+    static const uint64_t kClockInterval = 1024;
+
+    MatchLimits limits;
+    bool limited = false;
+    bool over = false;
+    uint64_t steps = 0;
+    uint64_t stepLimit = UINT64_MAX;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+#endif // BUDGET_H
@@ -0,0 +1,16 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+/**
+ * Compiler hints shared by the matchers.
+ *  - COLD_PATH: a function that is rarely called (growing a table, the
+ *    memoized fallback), kept out of line so the hot loop calling it stays
+ *    small and its registers aren't spilled for it.
+ */
+#if defined(__GNUC__)
+#define COLD_PATH __attribute__((noinline, cold))
+#else
+#define COLD_PATH
+#endif
+
+#endif // COMPILER_H
@@ -0,0 +1,476 @@
+#include "DFA.h"
+#include "Batch.h"
+#include "Compiler.h"
+#include "Fold.h"
+#include "Stats.h"
+#include <algorithm>
+
+LazyDFA::LazyDFA(const Program& p, bool anch, size_t budget)
+    : prog(p), anchored(anch), memoryBudget(budget), mark(p.code.size(), 0) {}
+
+/**
+ * Follow Split/Jump/Save from pc and add every reachable Char/Any/Class/Match
+ * instruction to set. Uses the generation counter in mark so a pc is only
+ * added once per closure.
+ */
+void LazyDFA::addClosure(std::vector<int>& set, int pc) {
+    stack.clear();
+    stack.push_back(pc);
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        if (mark[i] == generation) continue;
+        mark[i] = generation;
+
+        const Instruction& inst = prog.code[i];
+        switch (inst.op) {
+        case OpCode::Split:
+            // order doesn't matter here, the set is sorted afterwards
+            stack.push_back(inst.y);
+            stack.push_back(inst.x);
+            break;
+        case OpCode::Jump:
+            stack.push_back(inst.x);
+            break;
+        case OpCode::Save:
+            stack.push_back(i + 1);
+            break;
+        case OpCode::Char:
+        case OpCode::Any:
+        case OpCode::Class:
+        case OpCode::Match:
+            set.push_back(i);
+            break;
+        }
+    }
+}
+
+int LazyDFA::findOrAdd(std::vector<int>& set, bool seeding) {
+    std::sort(set.begin(), set.end());
+    if (set.empty() && !seeding) return kDead;
+
+    auto key = std::make_pair(set, seeding);
+    auto it = cache.find(key);
+    if (it != cache.end()) return it->second;
+
+    State st;
+    st.insts = set;
+    st.accepting = false;
+    st.seeding = seeding;
+    st.unseeded = seeding ? kUnknown : (int)states.size();
+    for (int pc : set) {
+        const Instruction& inst = prog.code[pc];
+        if (inst.op != OpCode::Match) continue;
+        st.accepting = true;
+        if (inst.x >= 0) st.programs.push_back(inst.x);
+    }
+    std::fill(std::begin(st.next), std::end(st.next), kUnknown);
+
+    memoryUsed += sizeof(State) + (2 * set.size() + st.programs.size()) * sizeof(int);
+    states.push_back(std::move(st));
+    int id = (int)states.size() - 1;
+    cache.emplace(std::move(key), id);
+    return id;
+}
+
+void LazyDFA::flush() {
+    states.clear();
+    cache.clear();
+    memoryUsed = 0;
+    start = kUnknown;
+    // state ids recorded by matchesInSeries() mean nothing anymore
+    flushes++;
+    newSeries();
+}
+
+int LazyDFA::startState() {
+    if (start == kUnknown) {
+        std::vector<int> set;
+        ++generation;
+        addClosure(set, prog.start);
+        start = findOrAdd(set, !anchored);
+    }
+    return start;
+}
+
+/**
+ * The state with the same instructions that no longer adds new starts, i.e.
+ * only follows the matches already in progress.
+ */
+int LazyDFA::stopSeeding(int s) {
+    if (states[s].unseeded == kUnknown) {
+        std::vector<int> set = states[s].insts;
+        int t = findOrAdd(set, false);
+        states[s].unseeded = t;
+    }
+    return states[s].unseeded;
+}
+
+int LazyDFA::step(int s, unsigned char b) {
+    int cached = states[s].next[b];
+    if (cached != kUnknown) return cached;
+
+    // Copy the source set: flushing below would invalidate states[s].
+    std::vector<int> from = states[s].insts;
+    bool seeding = states[s].seeding;
+    if (memoryUsed > memoryBudget) {
+        flush();
+        s = findOrAdd(from, seeding);
+    }
+
+    std::vector<int> set;
+    ++generation;
+    for (int pc : from) {
+        const Instruction& inst = prog.code[pc];
+        bool ok = false;
+        if (inst.op == OpCode::Any) {
+            ok = true;
+        } else if (inst.op == OpCode::Char) {
+            ok = (inst.foldCase ? foldLower(b) : b) == inst.ch;
+        } else if (inst.op == OpCode::Class) {
+            ok = prog.classes[inst.x][b];
+        }
+        if (ok) addClosure(set, pc + 1);
+    }
+    if (seeding) {
+        // implicit leading ".*": a new match may begin at every position
+        addClosure(set, prog.start);
+    }
+
+    int t = findOrAdd(set, seeding);
+    states[s].next[b] = t;
+    return t;
+}
+
+// Bytes a scan steps through between two charges of the budget.
+inline size_t LazyDFA::scanBlock() const {
+    return budget && budget->active() ? MatchBudget::kScanBlock : std::string::npos;
+}
+
+bool LazyDFA::matches(std::string_view text, size_t from) {
+    return earliestEnd(text, from) != std::string::npos;
+}
+
+size_t LazyDFA::earliestEnd(std::string_view text, size_t from, bool* hitEnd, size_t lastStart) {
+    if (hitEnd) *hitEnd = false;
+    int s = startState();
+    if (s != kDead && from >= lastStart) s = stopSeeding(s);
+    if (s == kDead) return std::string::npos;
+    if (states[s].accepting) return from;
+
+    // the budget is charged a block at a time, out of the loop over the bytes
+    size_t block = scanBlock();
+    for (size_t i = from; i < text.size(); ) {
+        if (i > from && !budget->charge(block)) return std::string::npos;
+        for (size_t stop = i + std::min(block, text.size() - i); i < stop; i++) {
+            MATCH_STATS(scanned++);
+            s = step(s, (unsigned char)text[i]);
+            // the state after text[i] holds the start at i + 1
+            if (s != kDead && i + 1 == lastStart) s = stopSeeding(s);
+            if (s == kDead) return std::string::npos;
+            if (states[s].accepting) return i + 1;
+        }
+    }
+    if (hitEnd) *hitEnd = true;
+    return std::string::npos;
+}
+
+size_t LazyDFA::longestMatch(std::string_view text, size_t from) {
+    int s = startState();
+    if (s == kDead) return std::string::npos;
+    size_t last = states[s].accepting ? from : std::string::npos;
+
+    size_t block = scanBlock();
+    for (size_t i = from; i < text.size(); ) {
+        if (i > from && !budget->charge(block)) return std::string::npos;
+        for (size_t stop = i + std::min(block, text.size() - i); i < stop; i++) {
+            MATCH_STATS(scanned++);
+            s = step(s, (unsigned char)text[i]);
+            if (s == kDead) return last;
+            if (states[s].accepting) last = i + 1;
+        }
+    }
+    return last;
+}
+
+size_t LazyDFA::longestMatchBackward(std::string_view text, size_t end, size_t floor, bool* reachedFloor) {
+    if (reachedFloor) *reachedFloor = false;
+    int s = startState();
+    if (s == kDead) return std::string::npos;
+    size_t first = states[s].accepting ? end : std::string::npos;
+
+    size_t block = scanBlock();
+    for (size_t i = end; i > floor; ) {
+        if (i < end && !budget->charge(block)) return std::string::npos;
+        for (size_t stop = i - std::min(block, i - floor); i > stop; i--) {
+            MATCH_STATS(scanned++);
+            s = step(s, (unsigned char)text[i - 1]);
+            if (s == kDead) return first;
+            if (states[s].accepting) first = i - 1;
+        }
+    }
+    if (reachedFloor) *reachedFloor = true;
+    return first;
+}
+
+/**
+ * runInSeries() at position seriesBase + k, in state s, of run 'run' from
+ * seriesBase + first: the visit of an earlier run there in the same state,
+ * if any. Otherwise this one is recorded in a way that no later run can get
+ * to anymore (of an older series, or of a position before 'first'). The
+ * ring only takes positions less than a window past 'first', so the ways of
+ * a slot that aren't free all hold this very position; if there are none
+ * left the ways are widened. Further on only the checkpoints are kept.
+ */
+inline const LazyDFA::Visit* LazyDFA::visit(size_t k, size_t first, int s, int32_t run) {
+    size_t lap = k / kMaxSeriesWindow;
+    size_t slot = k % kMaxSeriesWindow;
+    if (lap > UINT32_MAX - series) return nullptr;     // laps can't be told apart anymore
+    bool checkpoint = slot == 0 && lap > 0;
+    std::vector<Visit>& table = checkpoint ? checkpoints : visits;
+    size_t index = checkpoint ? lap : slot;
+    if ((index + 1) * seriesWays > table.size()) {
+        growVisits(table, index, checkpoint ? SIZE_MAX : kMaxSeriesWindow);
+    }
+    uint32_t tag = series + (uint32_t)lap;
+    if (lap >= laps) laps = (uint32_t)lap + 1;
+
+    Visit* free = nullptr;
+    Visit* ways = &table[index * seriesWays];
+    for (size_t w = 0; w < seriesWays; w++) {
+        Visit& v = ways[w];
+        if (v.series == tag && v.state == s) return &v;
+        if (!free && (v.series < series ||
+                      (v.series < tag && (v.series - series) * kMaxSeriesWindow + slot < first))) {
+            free = &v;
+        }
+    }
+    // the next runs start after 'first', so its own start is of no use to them
+    if (k <= first || (!checkpoint && k - first >= kMaxSeriesWindow)) return nullptr;
+    if (!free) {
+        if (seriesWays == kMaxSeriesWays) return nullptr;
+        widenVisits();
+        free = &table[index * seriesWays + seriesWays / 2];
+    }
+    *free = Visit{tag, s, run};
+    return nullptr;
+}
+
+COLD_PATH void LazyDFA::growVisits(std::vector<Visit>& table, size_t index, size_t limit) {
+    size_t slots = std::min(limit, std::max(index + 1, 2 * table.size() / seriesWays));
+    table.resize(slots * seriesWays);
+}
+
+// Twice as many ways per position, for visits and checkpoints alike.
+COLD_PATH void LazyDFA::widenVisits() {
+    size_t ways = 2 * seriesWays;
+    for (std::vector<Visit>* table : {&visits, &checkpoints}) {
+        std::vector<Visit> wide(table->size() / seriesWays * ways);
+        for (size_t i = 0; i < table->size(); i++) {
+            wide[i / seriesWays * ways + i % seriesWays] = (*table)[i];
+        }
+        table->swap(wide);
+    }
+    seriesWays = ways;
+}
+
+void LazyDFA::newSeries() {
+    if (series > UINT32_MAX - laps) {
+        // wrapped around: old visits could look current again
+        visits.clear();
+        checkpoints.clear();
+        series = 1;
+    } else {
+        series += laps;
+    }
+    laps = 1;
+    seriesBase = std::string::npos;
+    runResult.clear();
+}
+
+bool LazyDFA::matchesInSeries(std::string_view text, size_t from) {
+    return runInSeries(text, from) == Run::Match;
+}
+
+LazyDFA::Run LazyDFA::runInSeries(std::string_view text, size_t from) {
+    if (seriesBase == std::string::npos || from < seriesBase) {
+        newSeries();
+        seriesBase = from;
+    }
+    int32_t run = (int32_t)runResult.size();
+    runResult.push_back(Run::Dead);
+    size_t flushesBefore = flushes;
+
+    Run result = Run::Dead;
+    bool stopped = false;
+    size_t block = scanBlock();
+    size_t chargeAt = block == std::string::npos ? block : from + block;
+    int s = startState();
+    for (size_t i = from;; i++) {
+        if (s == kDead) break;
+        if (states[s].accepting) {
+            result = Run::Match;
+            break;
+        }
+        if (flushes == flushesBefore) {
+            if (const Visit* v = visit(i - seriesBase, from - seriesBase, s, run)) {
+                // the DFA is deterministic: from here on this run is that run
+                result = runResult[v->run];
+                break;
+            }
+        }
+        if (i == text.size()) {
+            result = Run::NeedsMore;
+            break;
+        }
+        if (i == chargeAt) {
+            if (!budget->charge(block)) {
+                stopped = true;
+                break;
+            }
+            chargeAt += block;
+        }
+        MATCH_STATS(scanned++);
+        s = step(s, (unsigned char)text[i]);
+    }
+
+    if (stopped) {
+        // the visits of this run lead to an answer it never got
+        newSeries();
+    } else if (flushes == flushesBefore) {
+        runResult[run] = result;
+    }
+    return result;
+}
+
+void LazyDFA::matchingPrograms(std::string_view text, std::vector<char>& matched) {
+    int s = startState();
+    for (size_t i = 0;; i++) {
+        if (s == kDead) return;
+        if (states[s].accepting) {
+            for (int k : states[s].programs) matched[k] = 1;
+        }
+        if (i == text.size()) return;
+        MATCH_STATS(scanned++);
+        s = step(s, (unsigned char)text[i]);
+    }
+}
+
+void LazyDFA::matchesBatch(const RecordBatch& batch, const std::vector<size_t>& records,
+                           std::vector<char>& matched) {
+    // the records in flight: which one, the next byte of it, its end and state
+    size_t record[kLanes];
+    const unsigned char* at[kLanes];
+    const unsigned char* end[kLanes];
+    int state[kLanes];
+    int live = 0;
+    size_t next = 0;    // first of records not yet started
+    const unsigned char* data = (const unsigned char*)batch.data.data();
+    // with limits every record is a search of its own: a budget per lane,
+    // charged a block at a time, with rounds no longer than a block
+    size_t block = scanBlock();
+    MatchBudget spent[kLanes];
+    const unsigned char* charged[kLanes];
+    bool over = false;
+
+    size_t flushesBefore = flushes;
+    int s0 = startState();
+    // puts the next record that isn't settled by the start state into lane l
+    auto admit = [&](int l) {
+        while (next < records.size()) {
+            size_t k = records[next++];
+            if (s0 != kDead && states[s0].accepting) {
+                matched[k] = 1;
+            } else if (s0 != kDead && batch.lengths[k] > 0) {
+                record[l] = k;
+                at[l] = data + batch.offsets[k];
+                end[l] = at[l] + batch.lengths[k];
+                state[l] = s0;
+                charged[l] = at[l];
+                if (block != std::string::npos) {
+                    spent[l] = *budget;
+                    spent[l].start();
+                }
+                return true;
+            }
+        }
+        return false;
+    };
+    while (live < kLanes && admit(live)) live++;
+    while (live > 0) {
+        // rounds of one step of every lane, for as long as no lane can end
+        // and the states are all known
+        const State* st = states.data();
+        size_t run = (size_t)(end[0] - at[0]);
+        for (int l = 1; l < live; l++) run = std::min(run, (size_t)(end[l] - at[l]));
+        run = std::min(run, block);
+        unsigned accepted = 0;
+        int unknown = -1;   // lane whose next state has to be built
+        size_t i = 0;
+        for (; i < run && !accepted; i++) {
+            for (int l = 0; l < live; l++) {
+                int t = st[state[l]].next[at[l][i]];
+                if (t < 0) {
+                    unknown = l;
+                    break;
+                }
+                state[l] = t;
+                accepted |= (unsigned)st[t].accepting << l;
+            }
+            if (unknown >= 0) break;
+        }
+        for (int l = 0; l < live; l++) {
+            size_t stepped = i + (unknown >= 0 && l < unknown);
+            at[l] += stepped;
+            MATCH_STATS(scanned += stepped);
+        }
+
+        bool dead = false;
+        if (unknown >= 0) {
+            int t = step(state[unknown], *at[unknown]);
+            if (flushes != flushesBefore) {
+                // the states of the other lanes are gone: finish them one by one
+                for (int l = 0; l < live; l++) {
+                    if (budget) budget->start();
+                    matched[record[l]] = matches(batch.record(record[l]));
+                    if (budget && budget->exceeded()) over = true;
+                }
+                flushesBefore = flushes;
+                s0 = startState();
+                live = 0;
+                while (live < kLanes && admit(live)) live++;
+                continue;
+            }
+            MATCH_STATS(scanned++);
+            at[unknown]++;
+            if (t == kDead) {
+                dead = true;
+            } else {
+                state[unknown] = t;
+                if (states[t].accepting) accepted |= 1u << unknown;
+            }
+        }
+
+        for (int l = live - 1; l >= 0; l--) {
+            if (accepted >> l & 1) {
+                matched[record[l]] = 1;
+            } else if (!(dead && l == unknown) && at[l] != end[l]) {
+                if ((size_t)(at[l] - charged[l]) < block) continue;
+                charged[l] += block;
+                if (spent[l].charge(block)) continue;
+                // this record's search ran over its limits: no match
+                over = true;
+            }
+            // start the next record in lane l, or give the lane up
+            if (admit(l)) continue;
+            live--;
+            record[l] = record[live];
+            at[l] = at[live];
+            end[l] = end[live];
+            state[l] = state[live];
+            charged[l] = charged[live];
+            if (block != std::string::npos) spent[l] = spent[live];
+        }
+    }
+    if (over) budget->setExceeded();
+}
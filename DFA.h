@@ -0,0 +1,178 @@
+#ifndef DFA_H
+#define DFA_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Budget.h"
+#include "Program.h"
+
+struct RecordBatch;
+
+/**
+ * LazyDFA
+ *  - runs a Program by subset construction, building DFA states on demand
+ *    while scanning and caching them (including their transitions) so that
+ *    later scans are a single table lookup per input byte.
+ *  - unanchored mode behaves as if the pattern started with ".*", so one
+ *    forward pass answers "is there a match anywhere?".
+ *  - if the cache grows past memoryBudget bytes it is flushed and rebuilt
+ *    from the state we are currently in.
+ *  - with a MatchBudget (setBudget()), the scans below charge it for the
+ *    bytes they step through; one that runs it out stops with no match.
+ */
+class LazyDFA {
+public:
+    explicit LazyDFA(const Program& prog, bool anchored,
+                     size_t memoryBudget = 8 * 1024 * 1024);
+
+    // Budget of the search the scans belong to (null: none).
+    void setBudget(MatchBudget* b) { budget = b; }
+
+    // Unanchored: does the Program match anywhere in text[from..]?
+    // Anchored: does it match some prefix of text[from..]?
+    bool matches(std::string_view text, size_t from = 0);
+
+    // Position right after the earliest point where a match ends,
+    // scanning text[from..] (std::string::npos if there is none).
+    // If hitEnd is given, it tells whether the answer npos came from running
+    // out of input (more input could still produce a match).
+    // Unanchored: only matches starting at or before lastStart count, so the
+    // scan can stop early once those have all died.
+    size_t earliestEnd(std::string_view text, size_t from = 0, bool* hitEnd = nullptr,
+                       size_t lastStart = std::string::npos);
+
+    // Anchored: end of the longest match of a prefix of text[from..]
+    // (std::string::npos if there is none).
+    size_t longestMatch(std::string_view text, size_t from);
+
+    /**
+     * Anchored, for a Program from reverseProgram(): steps through text
+     * backwards from end - 1 and returns the smallest s >= floor such that
+     * the original Program matches text[s, end) (std::string::npos if none).
+     * If reachedFloor is given, it tells whether the scan was still going at
+     * floor, i.e. whether a match could start before it.
+     */
+    size_t longestMatchBackward(std::string_view text, size_t end, size_t floor = 0,
+                                bool* reachedFloor = nullptr);
+
+    /**
+     * Anchored: same answer as matches(text, from), for a series of starts
+     * tried in increasing order on one text. Each run remembers the states
+     * it was in at every position, and a later run that gets to a position
+     * in a state an earlier run was in there stops with that run's answer,
+     * so overlapping runs (e.g. "a*ab" from every a) don't rescan the same
+     * text. A position keeps several states (e.g. both the odd and the even
+     * runs of "(..)*x"), up to kMaxSeriesWays.
+     * Past the first kMaxSeriesWindow positions the states go round a ring
+     * of that size, which only takes positions less than a window past the
+     * current start, plus one position per window that is kept for the whole
+     * series, so a run that goes further than the ring still meets the later
+     * runs within one window. As long as the runs get to no position in more
+     * than kMaxSeriesWays different states, a series steps through every byte
+     * of the text at most twice per state it is reached in; past that it can
+     * fall back to rescanning.
+     * newSeries() starts over, e.g. for another text.
+     */
+    bool matchesInSeries(std::string_view text, size_t from);
+    void newSeries();
+
+    // How a run of runInSeries() ended.
+    enum class Run : char {
+        Dead,       // no match starts at 'from', whatever follows text
+        Match,      // some prefix of text[from..] matches
+        NeedsMore   // no match in text, but more input could still make one
+    };
+
+    // Anchored, in the same series as matchesInSeries(), for input that is
+    // still arriving: tells a run that died from one that ran out of text.
+    Run runInSeries(std::string_view text, size_t from);
+
+    /**
+     * Unanchored, for a Program from combinePrograms(): sets matched[k] for
+     * every program k with a match somewhere in text (matched has one entry
+     * per program). Unlike matches() this always scans the whole text.
+     */
+    void matchingPrograms(std::string_view text, std::vector<char>& matched);
+
+    /**
+     * Unanchored: matched[k] = matches(batch.record(k)) for every k in
+     * records (matched has one entry per record of the batch). kLanes
+     * records are stepped through side by side, a byte of each in turn, so
+     * the transition lookups of different records don't wait on each other
+     * and no call or setup is paid per record. A round ends where the
+     * shortest record in flight does, so this pays off on records of a few
+     * dozen bytes and more. With a budget, each record is a search of its
+     * own against the budget's limits; one that runs over them counts as
+     * not matching, and the budget is left exceeded.
+     */
+    void matchesBatch(const RecordBatch& batch, const std::vector<size_t>& records,
+                      std::vector<char>& matched);
+
+    // Bytes stepped through so far (only counted with SIMPLEPARSER_STATS).
+    uint64_t bytesScanned() const { return scanned; }
+
+private:
+    static constexpr int kUnknown = -2;
+    static constexpr int kDead = -1;
+    static constexpr int kLanes = 8;
+
+    struct State {
+        std::vector<int> insts; // sorted pcs of Char/Any/Class/Match instructions
+        bool accepting;
+        std::vector<int> programs; // combined Program: x of each Match
+        bool seeding;   // adds a new start after every step (unanchored)
+        int unseeded;   // same set with seeding turned off
+        int next[256];
+    };
+
+    const Program& prog;
+    bool anchored;
+    size_t memoryBudget;
+    size_t memoryUsed = 0;
+
+    std::vector<State> states;
+    std::map<std::pair<std::vector<int>, bool>, int> cache;
+    int start = kUnknown;
+    size_t flushes = 0;
+    uint64_t scanned = 0;
+    MatchBudget* budget = nullptr;
+
+    // matchesInSeries(): states of earlier runs at each position
+    static constexpr size_t kMaxSeriesWindow = 1 << 14;
+    static constexpr size_t kMaxSeriesWays = 32;
+    struct Visit {
+        uint32_t series = 0;    // series + (position - seriesBase) / kMaxSeriesWindow
+        int32_t state = kUnknown;
+        int32_t run = 0;
+    };
+    uint32_t series = 1;
+    uint32_t laps = 1;              // values from series on taken by this series
+    size_t seriesBase = std::string::npos;
+    size_t seriesWays = 4;          // visits kept per position, widened as one needs more
+    std::vector<Visit> visits;      // ring: seriesWays per (position - seriesBase) % kMaxSeriesWindow
+    std::vector<Visit> checkpoints; // seriesWays per (position - seriesBase) / kMaxSeriesWindow past
+                                    // the first window, for the positions at ring index 0
+    std::vector<Run> runResult;     // answer of each run of the series
+
+    const Visit* visit(size_t k, size_t first, int s, int32_t run);
+    void growVisits(std::vector<Visit>& table, size_t index, size_t limit);
+    void widenVisits();
+
+    // scratch for closure computation
+    std::vector<unsigned> mark;
+    unsigned generation = 0;
+    std::vector<int> stack;
+
+    void addClosure(std::vector<int>& set, int pc);
+    int findOrAdd(std::vector<int>& set, bool seeding);
+    int startState();
+    int stopSeeding(int s);
+    int step(int s, unsigned char b);
+    void flush();
+    size_t scanBlock() const;
+};
+
+#endif // DFA_H
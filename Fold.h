@@ -0,0 +1,47 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <cstddef>
+
+/**
+ * Case folding for \I, by table.
+ *  - ASCII only and the same in every locale: std::tolower() follows the
+ *    C locale, so a program calling setlocale() would change what \I
+ *    matches, and it costs a call per byte.
+ *  - only A-Z and a-z have another case; every other byte folds to itself.
+ *  - matchers compare foldLower() of the input against pattern bytes that
+ *    were lowered when the pattern was compiled.
+ */
+struct FoldTable {
+    unsigned char lower[256];
+    unsigned char other[256];
+};
+
+constexpr FoldTable makeFoldTable() {
+    FoldTable t{};
+    for (int b = 0; b < 256; b++) {
+        t.lower[b] = t.other[b] = (unsigned char)b;
+    }
+    for (int b = 'A'; b <= 'Z'; b++) {
+        t.lower[b] = t.other[b] = (unsigned char)(b - 'A' + 'a');
+        t.other[b - 'A' + 'a'] = (unsigned char)b;
+    }
+    return t;
+}
+
+inline constexpr FoldTable kFoldTable = makeFoldTable();
+
+constexpr unsigned char foldLower(unsigned char c) { return kFoldTable.lower[c]; }
+
+// The other case of a letter, c itself for anything else.
+constexpr unsigned char otherCase(unsigned char c) { return kFoldTable.other[c]; }
+
+constexpr bool hasOtherCase(unsigned char c) { return kFoldTable.other[c] != c; }
+
+/**
+ * a[0..n) and b[0..n) are equal ignoring ASCII case. Compares 16 bytes at
+ * a time (SSE2 / NEON) and uses the table for the rest (Scan.cpp).
+ */
+bool equalFolded(const char* a, const char* b, size_t n);
+
+#endif // FOLD_H
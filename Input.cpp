@@ -0,0 +1,224 @@
+#include "Input.h"
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#define read _read
+#define open _open
+#define close _close
+#else
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    map(fd);
+    close(fd);
+}
+
+MappedFile::MappedFile(int fd) {
+    map(fd);
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped) munmap((void*)data, size);
+#endif
+}
+
+bool MappedFile::isRegularFile(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+}
+
+void MappedFile::map(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return;
+    size = (size_t)st.st_size;
+    if (size == 0) {
+        // nothing to map, but a valid (empty) input
+        valid = true;
+        return;
+    }
+
+#ifndef _WIN32
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+        madvise(p, size, MADV_SEQUENTIAL);
+        data = (const char*)p;
+        mapped = true;
+        valid = true;
+        return;
+    }
+#endif
+
+    // no mmap: read the whole file instead
+    fallback.resize(size);
+    size_t got = 0;
+    while (got < size) {
+        long n = (long)read(fd, fallback.data() + got, (unsigned)(size - got));
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    size = got;
+    data = fallback.data();
+    valid = true;
+}
+
+// read() retried on EINTR; 0 at the end of the stream, < 0 on errors.
+static long readSome(int fd, char* to, size_t size) {
+    long n;
+    do {
+        n = (long)read(fd, to, (unsigned)size);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+/**
+ * The reader thread of a ChunkReader with readAhead > 0. It waits in poll()
+ * on the stream and on a pipe of its own, so the ChunkReader can stop it
+ * even while the stream has nothing to read (e.g. a terminal).
+ */
+struct ChunkReader::ReadAhead {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<char>> ready;  // chunks read, in stream order
+    std::vector<std::vector<char>> spare; // emptied chunks, for reuse
+    size_t limit;
+    bool done = false;      // the stream ended (or failed)
+    bool stop = false;
+    int wake[2] = {-1, -1};
+    std::thread thread;
+
+    void run(int fd, size_t chunkSize);
+};
+
+void ChunkReader::ReadAhead::run(int fd, size_t chunkSize) {
+#ifndef _WIN32
+    while (true) {
+        std::vector<char> chunk;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&] { return stop || ready.size() < limit; });
+            if (stop) return;
+            if (!spare.empty()) {
+                chunk = std::move(spare.back());
+                spare.pop_back();
+            }
+        }
+        chunk.resize(chunkSize);
+
+        pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+        while (poll(fds, 2, -1) < 0 && errno == EINTR) {}
+        if (fds[1].revents) return;
+        long n = readSome(fd, chunk.data(), chunkSize);
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (n <= 0) {
+            done = true;
+            changed.notify_all();
+            return;
+        }
+        chunk.resize((size_t)n);
+        ready.push_back(std::move(chunk));
+        changed.notify_all();
+    }
+#else
+    (void)fd;
+    (void)chunkSize;
+#endif
+}
+
+ChunkReader::ChunkReader(int f, size_t chunk, size_t readAhead)
+    : fd(f), chunkSize(chunk) {
+#ifndef _WIN32
+    if (readAhead == 0) return;
+    ahead.reset(new ReadAhead());
+    ahead->limit = readAhead;
+    if (pipe(ahead->wake) != 0) {
+        ahead.reset();
+        return;
+    }
+    ahead->thread = std::thread([this] { ahead->run(fd, chunkSize); });
+#else
+    (void)readAhead;
+#endif
+}
+
+ChunkReader::~ChunkReader() {
+#ifndef _WIN32
+    if (!ahead) return;
+    {
+        std::lock_guard<std::mutex> guard(ahead->lock);
+        ahead->stop = true;
+        ahead->changed.notify_all();
+    }
+    char c = 0;
+    while (write(ahead->wake[1], &c, 1) < 0 && errno == EINTR) {}
+    ahead->thread.join();
+    close(ahead->wake[0]);
+    close(ahead->wake[1]);
+#endif
+}
+
+// Appends the chunks the reader thread has ready, waiting for at least one.
+bool ChunkReader::takeReady() {
+    std::deque<std::vector<char>> chunks;
+    {
+        std::unique_lock<std::mutex> guard(ahead->lock);
+        ahead->changed.wait(guard, [&] { return !ahead->ready.empty() || ahead->done; });
+        chunks.swap(ahead->ready);
+        // the reader can go on while the chunks are copied
+        ahead->changed.notify_all();
+    }
+    if (chunks.empty()) return false;
+
+    size_t total = 0;
+    for (const auto& chunk : chunks) total += chunk.size();
+    if (buffer.size() < length + total) buffer.resize(length + total);
+    for (auto& chunk : chunks) {
+        std::memcpy(buffer.data() + length, chunk.data(), chunk.size());
+        length += chunk.size();
+    }
+
+    std::lock_guard<std::mutex> guard(ahead->lock);
+    for (auto& chunk : chunks) ahead->spare.push_back(std::move(chunk));
+    return true;
+}
+
+bool ChunkReader::refill(size_t keepFrom) {
+    // carry the undecided tail over to the front of the buffer
+    keepFrom += consumed;
+    consumed = 0;
+    if (keepFrom > 0) {
+        length -= keepFrom;
+        std::memmove(buffer.data(), buffer.data() + keepFrom, length);
+    }
+    if (atEof) return false;
+
+    if (ahead) {
+        if (!takeReady()) atEof = true;
+        return !atEof;
+    }
+
+    if (buffer.size() < length + chunkSize) {
+        buffer.resize(length + chunkSize);
+    }
+    long n = readSome(fd, buffer.data() + length, chunkSize);
+    if (n <= 0) {
+        atEof = true;
+        return false;
+    }
+    length += (size_t)n;
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * MappedFile
+ *  - maps a regular file read-only into memory, so the matcher can work on
+ *    the page cache directly without copying the input.
+ *  - on platforms without mmap the file is read into an owned buffer.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    // Maps an already open descriptor (e.g. stdin redirected from a file).
+    explicit MappedFile(int fd);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool ok() const { return valid; }
+    std::string_view view() const { return std::string_view(data, size); }
+
+    // True if fd refers to a regular file that can be mapped.
+    static bool isRegularFile(int fd);
+
+private:
+    void map(int fd);
+
+    const char* data = nullptr;
+    size_t size = 0;
+    bool valid = false;
+    bool mapped = false;
+    std::vector<char> fallback;
+};
+
+/**
+ * ChunkReader
+ *  - reads a stream (pipe, terminal) in fixed-size chunks.
+ *  - refill(keepFrom) drops everything before keepFrom and appends the next
+ *    chunk after what is kept, so a partially matched tail carries over to
+ *    the next chunk; memory only grows while that tail is still undecided.
+ *  - with readAhead > 0 a reader thread keeps up to that many chunks read
+ *    in advance, so waiting for the stream overlaps with matching the
+ *    chunk before; refill() then appends every chunk that is ready and only
+ *    blocks when none is. Without it (and on Windows) refill() reads itself.
+ */
+class ChunkReader {
+public:
+    explicit ChunkReader(int fd, size_t chunkSize = 64 * 1024, size_t readAhead = 0);
+    ~ChunkReader();
+
+    ChunkReader(const ChunkReader&) = delete;
+    ChunkReader& operator=(const ChunkReader&) = delete;
+
+    // Returns false once the end of the stream has been reached.
+    bool refill(size_t keepFrom);
+
+    // Drops the first count bytes of view() without reading anything; their
+    // memory is reclaimed by the next refill().
+    void consume(size_t count) { consumed += std::min(count, length - consumed); }
+
+    std::string_view view() const { return std::string_view(buffer.data() + consumed, length - consumed); }
+    bool eof() const { return atEof; }
+
+private:
+    struct ReadAhead;
+
+    int fd;
+    size_t chunkSize;
+    std::vector<char> buffer;
+    size_t length = 0;
+    size_t consumed = 0;    // bytes before view() that refill() hasn't dropped yet
+    bool atEof = false;
+    std::unique_ptr<ReadAhead> ahead;
+
+    bool takeReady();
+};
+
+#endif // INPUT_H
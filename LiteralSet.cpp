@@ -0,0 +1,107 @@
+#include "LiteralSet.h"
+#include "Fold.h"
+#include <cstring>
+
+static unsigned char fold(unsigned char b) {
+    return foldLower(b);
+}
+
+LiteralSet::LiteralSet(const std::vector<Literal>& lits) : literals(lits) {
+    // columns: one per distinct folded byte used by the literals, 0 for the rest
+    int columnOf[256] = {0};
+    for (const Literal& lit : literals) {
+        for (char c : lit.text) {
+            unsigned char b = fold((unsigned char)c);
+            if (columnOf[b] == 0) columnOf[b] = (int)columns++;
+        }
+    }
+    for (int b = 0; b < 256; b++) {
+        byteClass[b] = (uint8_t)columnOf[fold((unsigned char)b)];
+    }
+
+    // the trie, with -1 for missing edges
+    std::vector<std::vector<int32_t>> ends(1);
+    next.assign(columns, -1);
+    for (size_t id = 0; id < literals.size(); id++) {
+        const std::string& text = literals[id].text;
+        if (text.empty()) continue;
+        searchable++;
+        int32_t s = 0;
+        for (char c : text) {
+            int32_t& edge = next[s * columns + byteClass[(unsigned char)c]];
+            if (edge < 0) {
+                edge = (int32_t)ends.size();
+                ends.emplace_back();
+                next.resize(next.size() + columns, -1);
+            }
+            s = next[s * columns + byteClass[(unsigned char)c]];
+        }
+        ends[s].push_back((int32_t)id);
+    }
+
+    // Breadth-first, so the failure target of a state is finished before it:
+    // missing edges are taken from there, and so are the literals that end
+    // in a suffix of the state.
+    size_t states = ends.size();
+    std::vector<int32_t> failure(states, 0);
+    std::vector<int32_t> queue;
+    for (size_t c = 0; c < columns; c++) {
+        int32_t& t = next[c];
+        if (t < 0) {
+            t = 0;
+        } else {
+            queue.push_back(t);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        int32_t s = queue[head];
+        const std::vector<int32_t>& inherited = ends[failure[s]];
+        ends[s].insert(ends[s].end(), inherited.begin(), inherited.end());
+        for (size_t c = 0; c < columns; c++) {
+            int32_t& t = next[s * columns + c];
+            int32_t viaFailure = next[failure[s] * columns + c];
+            if (t < 0) {
+                t = viaFailure;
+            } else {
+                failure[t] = viaFailure;
+                queue.push_back(t);
+            }
+        }
+    }
+
+    first.assign(states, -1);
+    for (size_t s = 0; s < states; s++) {
+        if (ends[s].empty()) continue;
+        first[s] = (int32_t)outputs.size();
+        outputs.insert(outputs.end(), ends[s].begin(), ends[s].end());
+        outputs.push_back(-1);
+    }
+}
+
+size_t LiteralSet::find(std::string_view text, std::vector<char>& found) const {
+    size_t count = 0;
+    size_t missing = searchable;
+    for (size_t id = 0; id < literals.size(); id++) {
+        if (found[id] && !literals[id].text.empty()) missing--;
+    }
+    if (missing == 0) return 0;
+
+    int32_t s = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        s = next[s * columns + byteClass[(unsigned char)text[i]]];
+        if (first[s] < 0) continue;
+
+        for (const int32_t* id = &outputs[first[s]]; *id >= 0; id++) {
+            if (found[*id]) continue;
+            const Literal& lit = literals[*id];
+            size_t n = lit.text.size();
+            if (!lit.foldCase && std::memcmp(text.data() + i + 1 - n, lit.text.data(), n) != 0) {
+                continue;
+            }
+            found[*id] = 1;
+            count++;
+            if (--missing == 0) return count;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,43 @@
+#ifndef LITERAL_SET_H
+#define LITERAL_SET_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "Analysis.h"
+
+/**
+ * LiteralSet
+ *  - Aho-Corasick automaton over many literals: one pass over a text tells
+ *    which of them occur in it, however many there are.
+ *  - the transitions are a full table (no failure links to follow while
+ *    scanning), over the classes of bytes that appear in some literal plus
+ *    one class for all other bytes, so the table stays small.
+ *  - the automaton works on case-folded bytes; a hit of a literal that is
+ *    not foldCase is checked against the exact text before it counts.
+ */
+class LiteralSet {
+public:
+    // Literal i gets id i; empty literals are never reported.
+    explicit LiteralSet(const std::vector<Literal>& literals);
+
+    /**
+     * Sets found[i] for every literal i that occurs in text (found must have
+     * one entry per literal). Stops early once all of them have been seen.
+     * Returns the number of entries it set.
+     */
+    size_t find(std::string_view text, std::vector<char>& found) const;
+
+    size_t size() const { return literals.size(); }
+
+private:
+    std::vector<Literal> literals;
+    size_t searchable = 0;       // non-empty literals
+    uint8_t byteClass[256];      // case-folded byte -> column of the table
+    size_t columns = 1;
+    std::vector<int32_t> next;   // state * columns + class -> state
+    std::vector<int32_t> first;  // state -> its first entry in outputs, -1 if none
+    std::vector<int32_t> outputs; // literal ids ending at a state, -1 terminated
+};
+
+#endif // LITERAL_SET_H
@@ -0,0 +1,71 @@
+#include "Memo.h"
+#include <algorithm>
+
+void MatchMemo::reset() {
+    if (++generation == 0) {
+        // wrapped around: old stamps could look current again
+        std::fill(stamp.begin(), stamp.end(), 0);
+        generation = 1;
+    }
+    data = nullptr;
+}
+
+bool MatchMemo::begin(std::string_view text, size_t start, int32_t slots) {
+    if (budget == 0 || slots <= 0) return false;
+
+    if (text.data() == data && text.size() == size && slots == slotCount && start >= base) {
+        // well inside the window, or the window already reaches the end
+        if (start - base < width / 2 || base + width == text.size() + 1) return true;
+    }
+    reset();
+    data = text.data();
+    size = text.size();
+    slotCount = slots;
+    base = std::min(start, text.size());
+
+    // a bit plus a 32-bit length per entry
+    size_t perPosition = (size_t)slots * (sizeof(uint32_t) + 1);
+    width = std::min(text.size() + 1 - base, std::max<size_t>(budget / perPosition, 1));
+
+    size_t entries = (size_t)slots * width;
+    size_t words = (entries + 63) / 64;
+    if (known.size() < words) {
+        known.resize(words);
+        stamp.resize(words, 0);
+    }
+    if (length.size() < entries) length.resize(entries);
+    return true;
+}
+
+bool MatchMemo::index(int32_t slot, size_t pos, size_t& i) const {
+    if (pos < base || pos - base >= width) return false;
+    i = (size_t)slot * width + (pos - base);
+    return true;
+}
+
+bool MatchMemo::lookup(int32_t slot, size_t pos, size_t& end) const {
+    size_t i;
+    if (!index(slot, pos, i) || stamp[i / 64] != generation || !(known[i / 64] >> (i % 64) & 1)) {
+        return false;
+    }
+    end = length[i] == kFailed ? std::string::npos : pos + length[i];
+    return true;
+}
+
+void MatchMemo::store(int32_t slot, size_t pos, size_t end) {
+    size_t i;
+    if (!index(slot, pos, i)) return;
+    if (end == std::string::npos) {
+        length[i] = kFailed;
+    } else if (end - pos < kFailed) {
+        length[i] = (uint32_t)(end - pos);
+    } else {
+        return;
+    }
+    size_t w = i / 64;
+    if (stamp[w] != generation) {
+        stamp[w] = generation;
+        known[w] = 0;
+    }
+    known[w] |= (uint64_t)1 << (i % 64);
+}
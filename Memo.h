@@ -0,0 +1,70 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * MatchMemo
+ *  - packrat-style table for the flat tree matcher (Arena.h): for every node
+ *    that got a memo slot (one without capture groups below it) and every
+ *    input position, whether the node was already tried there and where its
+ *    match ended, or that it failed.
+ *  - matching never backtracks into a node that succeeded, so such a result
+ *    depends only on (node, position) and stays valid for every start tried
+ *    in one search. Each node is then evaluated at most once per position,
+ *    which bounds the tree matcher to O(nodes x input) steps per search.
+ *  - covers a window of positions sized from the memory budget; the window
+ *    moves forward with the starts and positions outside it just aren't
+ *    memoized.
+ *  - the known bits are kept in 64-bit words, each stamped with the
+ *    generation that wrote it, so reset() is O(1) however large the window.
+ */
+class MatchMemo {
+public:
+    static const size_t kDefaultBudget = 16 * 1024 * 1024;
+
+    // Bytes the table may use; 0 turns memoization off.
+    void setBudget(size_t bytes) { budget = bytes; }
+    size_t getBudget() const { return budget; }
+
+    // Forgets everything (the next search may use other text at the same address).
+    void reset();
+
+    /**
+     * Called before each match attempt at 'start' with 'slots' memo slots.
+     * Keeps what is known if start is still well inside the window of the
+     * same text, otherwise moves the window and starts over.
+     * Returns false if the table can't be used (budget 0 or no slots).
+     */
+    bool begin(std::string_view text, size_t start, int32_t slots);
+
+    // Result of slot at pos if known: end of its match, or npos if it failed.
+    bool lookup(int32_t slot, size_t pos, size_t& end) const;
+    void store(int32_t slot, size_t pos, size_t end);
+
+    // Positions of the Star loop being evaluated (a stack shared by nested loops).
+    std::vector<size_t>& path() { return loop; }
+
+private:
+    static const uint32_t kFailed = UINT32_MAX;
+
+    size_t budget = kDefaultBudget;
+    const char* data = nullptr;
+    size_t size = 0;
+    int32_t slotCount = 0;
+    size_t base = 0;      // first position of the window
+    size_t width = 0;     // positions per slot
+
+    uint32_t generation = 1;
+    std::vector<uint64_t> known;   // one bit per (slot, position)
+    std::vector<uint32_t> stamp;   // generation of each word of known
+    std::vector<uint32_t> length;  // match length, or kFailed
+    std::vector<size_t> loop;
+
+    bool index(int32_t slot, size_t pos, size_t& i) const;
+};
+
+#endif // MEMO_H
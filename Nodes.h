@@ -2,9 +2,11 @@
 #define NODES_H
 
 #include "AST.h"
+#include "Fold.h"
 #include <iostream>
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 
 /**
  * CharacterNode
@@ -22,7 +24,7 @@ public:
         char inputChar = ctx.currentChar();
         // If ignoring case, compare lowercased
         if (ctx.ignoreCase) {
-            if (std::tolower(inputChar) == std::tolower(ch)) {
+            if (foldLower((unsigned char)inputChar) == foldLower((unsigned char)ch)) {
                 ctx.position++;
                 return true;
             }
@@ -35,6 +37,9 @@ public:
         return false;
     }
 
+    NodeKind kind() const override { return NodeKind::Character; }
+    char getChar() const { return ch; }
+
 private:
     char ch;
 };
@@ -53,6 +58,8 @@ public:
         ctx.position++;
         return true;
     }
+
+    NodeKind kind() const override { return NodeKind::Dot; }
 };
 
 /**
@@ -82,6 +89,9 @@ public:
         return true;
     }
 
+    NodeKind kind() const override { return NodeKind::Sequence; }
+    const std::vector<std::shared_ptr<ASTNode>>& getChildren() const { return children; }
+
 private:
     std::vector<std::shared_ptr<ASTNode>> children;
 };
@@ -113,6 +123,10 @@ public:
         return false;
     }
 
+    NodeKind kind() const override { return NodeKind::Or; }
+    const std::shared_ptr<ASTNode>& getLeft() const { return lhs; }
+    const std::shared_ptr<ASTNode>& getRight() const { return rhs; }
+
 private:
     std::shared_ptr<ASTNode> lhs, rhs;
 };
@@ -147,6 +161,10 @@ public:
         return true;
     }
 
+    NodeKind kind() const override { return NodeKind::Group; }
+    const std::shared_ptr<ASTNode>& getExpr() const { return expr; }
+    int getGroupIndex() const { return groupIndex; }
+
 private:
     std::shared_ptr<ASTNode> expr;
     int groupIndex; // -1 means no capturing, 0 means entire match, etc.
@@ -176,10 +194,15 @@ class StarNode : public ASTNode {
                     break;
                 }
                 count++;
+                // an iteration that consumed nothing would repeat forever
+                if (ctx.position == savedPos) break;
             }
             // If we require at least 1 repetition, check count:
             return (count >= 1);
         }
+
+        NodeKind kind() const override { return NodeKind::Star; }
+        const std::shared_ptr<ASTNode>& getExpr() const { return expr; }
     
     private:
         std::shared_ptr<ASTNode> expr;
@@ -210,6 +233,10 @@ public:
         return true;
     }
 
+    NodeKind kind() const override { return NodeKind::Count; }
+    const std::shared_ptr<ASTNode>& getExpr() const { return expr; }
+    int getCount() const { return count; }
+
 private:
     std::shared_ptr<ASTNode> expr;
     int count;
@@ -235,6 +262,9 @@ public:
         return ok;
     }
 
+    NodeKind kind() const override { return NodeKind::IgnoreCase; }
+    const std::shared_ptr<ASTNode>& getExpr() const { return expr; }
+
 private:
     std::shared_ptr<ASTNode> expr;
 };
@@ -257,10 +287,107 @@ public:
         return true;
     }
 
+    NodeKind kind() const override { return NodeKind::OutputGroup; }
     int getGroupIndex() const { return groupIndex; }
 
 private:
     int groupIndex;
 };
 
+/**
+ * LiteralNode
+ *  - matches the characters of 'text' one after the other, like a
+ *    SequenceNode of CharacterNodes but in a single comparison.
+ *  - with foldCase (or ctx.ignoreCase) letters compare ignoring case.
+ */
+class LiteralNode : public ASTNode {
+public:
+    LiteralNode(std::string s, bool fold) : text(std::move(s)), foldCase(fold) {}
+
+    bool match(MatchContext& ctx) override {
+        return matchText(ctx, text.data(), text.size(), foldCase || ctx.ignoreCase);
+    }
+
+    // Shared with the flat matcher (Arena.cpp).
+    static bool matchText(MatchContext& ctx, const char* text, size_t n, bool foldCase) {
+        size_t left = ctx.input.size() - ctx.position;
+        size_t avail = std::min(left, n);
+        const char* in = ctx.input.data() + ctx.position;
+        if (foldCase) {
+            if (!equalFolded(in, text, avail)) return false;
+        } else if (std::memcmp(in, text, avail) != 0) {
+            return false;
+        }
+        // the characters seen so far agree, the rest is past the end
+        if (avail < n) {
+            ctx.hitEnd = true;
+            return false;
+        }
+        ctx.position += n;
+        return true;
+    }
+
+    NodeKind kind() const override { return NodeKind::Literal; }
+    const std::string& getText() const { return text; }
+    bool getFoldCase() const { return foldCase; }
+
+private:
+    std::string text;
+    bool foldCase;
+};
+
+/**
+ * CharClassNode
+ *  - matches one character that is in 'set' (what a+b+c becomes).
+ */
+class CharClassNode : public ASTNode {
+public:
+    explicit CharClassNode(const ByteSet& s) : set(s) {}
+
+    bool match(MatchContext& ctx) override {
+        if (ctx.atEnd()) return false;
+        unsigned char b = (unsigned char)ctx.currentChar();
+        bool ok = set[b] || (ctx.ignoreCase && set[otherCase(b)]);
+        if (!ok) return false;
+        ctx.position++;
+        return true;
+    }
+
+    NodeKind kind() const override { return NodeKind::CharClass; }
+    const ByteSet& getSet() const { return set; }
+
+    // The set, plus the other case of every letter in it if foldCase.
+    ByteSet getSet(bool foldCase) const { return foldCase ? folded(set) : set; }
+
+    static ByteSet folded(const ByteSet& s) {
+        ByteSet r = s;
+        for (int b = 0; b < 256; b++) {
+            if (s[b]) {
+                r.set(otherCase((unsigned char)b));
+            }
+        }
+        return r;
+    }
+
+private:
+    ByteSet set;
+};
+
+/**
+ * DotStarNode
+ *  - ".*": one or more of anything, which never gives back, so it simply
+ *    takes the rest of the input (and always looks at its end).
+ */
+class DotStarNode : public ASTNode {
+public:
+    bool match(MatchContext& ctx) override {
+        if (ctx.atEnd()) return false;
+        ctx.position = ctx.input.size();
+        ctx.hitEnd = true;
+        return true;
+    }
+
+    NodeKind kind() const override { return NodeKind::DotStar; }
+};
+
 #endif // NODES_H
@@ -0,0 +1,122 @@
+#include "OnePass.h"
+#include "Fold.h"
+#include <map>
+#include <string>
+
+// A position reachable without consuming anything, and the slots saved on the way.
+struct Reach {
+    int pc;
+    std::vector<int16_t> saved;
+};
+
+/**
+ * Follows Split / Jump / Save from pc to the consuming instructions and
+ * Match. False if an instruction can be reached on two paths: the Program
+ * would then not be one-pass (or not obviously so).
+ */
+static bool closure(const Program& prog, int pc, std::vector<Reach>& out, std::optional<Reach>& match) {
+    out.clear();
+    match.reset();
+    std::vector<char> seen(prog.code.size(), 0);
+    std::vector<Reach> stack{Reach{pc, {}}};
+    while (!stack.empty()) {
+        Reach r = std::move(stack.back());
+        stack.pop_back();
+        if (seen[r.pc]) return false;
+        seen[r.pc] = 1;
+
+        const Instruction& inst = prog.code[r.pc];
+        switch (inst.op) {
+        case OpCode::Split:
+            stack.push_back(Reach{inst.y, r.saved});
+            stack.push_back(Reach{inst.x, std::move(r.saved)});
+            break;
+        case OpCode::Jump:
+            stack.push_back(Reach{inst.x, std::move(r.saved)});
+            break;
+        case OpCode::Save:
+            r.saved.push_back((int16_t)inst.x);
+            r.pc++;
+            stack.push_back(std::move(r));
+            break;
+        case OpCode::Match:
+            match = std::move(r);
+            break;
+        case OpCode::Char:
+        case OpCode::Any:
+        case OpCode::Class:
+            out.push_back(std::move(r));
+            break;
+        }
+    }
+    return true;
+}
+
+std::optional<OnePass> OnePass::compile(const Program& prog) {
+    if (prog.slotCount > INT16_MAX) return std::nullopt;
+    // state 0 is the start, state k + 1 comes after position k
+    std::vector<int> state(prog.code.size(), -1);
+    std::vector<int> entry{prog.start};
+    for (size_t pc = 0; pc < prog.code.size(); pc++) {
+        OpCode op = prog.code[pc].op;
+        if (op == OpCode::Char || op == OpCode::Any || op == OpCode::Class) {
+            if (entry.size() == (size_t)kMaxStates) return std::nullopt;
+            state[pc] = (int)entry.size();
+            entry.push_back((int)pc + 1);
+        }
+    }
+
+    OnePass op;
+    op.slotCount = prog.slotCount;
+    op.table.assign(entry.size() * 256, kDead);
+    op.matchSaves.assign(entry.size(), -1);
+    op.saves.push_back(-1);
+    std::map<std::vector<int16_t>, int32_t> lists{{{}, 0}};
+    auto listOf = [&](const std::vector<int16_t>& saved) {
+        auto it = lists.find(saved);
+        if (it != lists.end()) return it->second;
+        int32_t at = (int32_t)op.saves.size();
+        op.saves.insert(op.saves.end(), saved.begin(), saved.end());
+        op.saves.push_back(-1);
+        lists.emplace(saved, at);
+        return at;
+    };
+
+    std::vector<Reach> reach;
+    std::optional<Reach> match;
+    for (size_t s = 0; s < entry.size(); s++) {
+        if (!closure(prog, entry[s], reach, match)) return std::nullopt;
+        if (match) op.matchSaves[s] = listOf(match->saved);
+        uint32_t* row = &op.table[s * 256];
+        for (const Reach& r : reach) {
+            const Instruction& inst = prog.code[r.pc];
+            uint32_t to = (uint32_t)state[r.pc] | ((uint32_t)listOf(r.saved) << 16);
+            for (int b = 0; b < 256; b++) {
+                bool takes = inst.op == OpCode::Any ||
+                             (inst.op == OpCode::Class && prog.classes[inst.x][b]) ||
+                             (inst.op == OpCode::Char && (b == inst.ch || (inst.foldCase && b == otherCase(inst.ch))));
+                if (!takes) continue;
+                // two positions taking the same byte: not one-pass
+                if (row[b] != kDead) return std::nullopt;
+                row[b] = to;
+            }
+        }
+        if (op.saves.size() > 0xffff) return std::nullopt;
+    }
+    return op;
+}
+
+bool OnePass::capture(std::string_view text, size_t start, std::vector<size_t>& slots) const {
+    slots.assign(slotCount, std::string::npos);
+    const unsigned char* p = (const unsigned char*)text.data();
+    uint32_t at = 0;
+    for (size_t i = start; i < text.size(); i++) {
+        uint32_t t = table[at * 256 + p[i]];
+        if (t == kDead) return false;
+        for (const int16_t* s = &saves[t >> 16]; *s >= 0; s++) slots[*s] = i;
+        at = t & 0xffff;
+    }
+    if (matchSaves[at] < 0) return false;
+    for (const int16_t* s = &saves[matchSaves[at]]; *s >= 0; s++) slots[*s] = text.size();
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef ONE_PASS_H
+#define ONE_PASS_H
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "Program.h"
+
+/**
+ * OnePass
+ *  - capture extraction in one forward scan, for Programs that are
+ *    one-pass: wherever the Program is, the next byte leaves at most one
+ *    way to go on (as in "(\w*)=(.)", not "(a*)a"). Then a match has just
+ *    one path through the Program and the Save instructions on it are the
+ *    captures, so no threads, no backtracking and no capture copies.
+ *  - a state per position (its Char / Any / Class instruction) plus the
+ *    start; each state has a row of 256 transitions, each naming the next
+ *    state and the slots to save before the byte is consumed.
+ *  - for a deterministic pattern (Analysis.h) cut at the end of its match
+ *    the captures are those of the tree matcher: every node consumes, so a
+ *    branch the tree matcher tries in vain fails at its first byte, before
+ *    any group inside it is done.
+ *  - built once with the CompiledPattern and never changes.
+ */
+class OnePass {
+public:
+    static constexpr int kMaxStates = 256;
+
+    // Nothing if the Program isn't one-pass or has too many positions.
+    static std::optional<OnePass> compile(const Program& prog);
+
+    /**
+     * Runs the Program anchored at 'start' over all of 'text' and fills in
+     * slots (Program::slotCount of them, npos if not saved). False if the
+     * Program doesn't match exactly text[start, text.size()).
+     */
+    bool capture(std::string_view text, size_t start, std::vector<size_t>& slots) const;
+
+private:
+    static constexpr uint32_t kDead = 0xffffffff;
+
+    // next state in the low 16 bits, offset of its save list in saves above them
+    std::vector<uint32_t> table;
+    std::vector<int32_t> matchSaves;  // per state: list saved on reaching Match, -1 if it can't
+    std::vector<int16_t> saves;       // save lists, each ended by -1; offset 0 is the empty list
+    int slotCount = 0;
+};
+
+#endif // ONE_PASS_H
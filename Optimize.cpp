@@ -0,0 +1,162 @@
+#include "Optimize.h"
+#include "Fold.h"
+#include "Nodes.h"
+
+using NodePtr = std::shared_ptr<ASTNode>;
+
+// Longest literal built by fusing or unrolling, keeps x{100000} from blowing up.
+static const size_t kMaxLiteral = 256;
+
+static NodePtr makeLiteral(std::string text, bool foldCase) {
+    if (foldCase) {
+        for (char& c : text) c = (char)foldLower((unsigned char)c);
+    }
+    return std::make_shared<LiteralNode>(std::move(text), foldCase);
+}
+
+// If the (already optimized) node matches exactly one byte, the bytes it accepts.
+static bool singleByte(const NodePtr& node, ByteSet& set) {
+    if (!node) return false;
+    switch (node->kind()) {
+    case NodeKind::Dot:
+        set.set();
+        return true;
+    case NodeKind::CharClass:
+        set = std::static_pointer_cast<CharClassNode>(node)->getSet();
+        return true;
+    case NodeKind::Literal: {
+        auto lit = std::static_pointer_cast<LiteralNode>(node);
+        if (lit->getText().size() != 1) return false;
+        ByteSet one;
+        one.set((unsigned char)lit->getText()[0]);
+        set = lit->getFoldCase() ? CharClassNode::folded(one) : one;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static NodePtr optimizeNode(const NodePtr& node, bool foldCase);
+
+static NodePtr optimizeSequence(const SequenceNode& seq, bool foldCase) {
+    std::vector<NodePtr> parts;
+    auto append = [&](const NodePtr& c) {
+        if (c && c->kind() == NodeKind::Literal && !parts.empty() && parts.back()
+            && parts.back()->kind() == NodeKind::Literal) {
+            auto a = std::static_pointer_cast<LiteralNode>(parts.back());
+            auto b = std::static_pointer_cast<LiteralNode>(c);
+            if (a->getFoldCase() == b->getFoldCase()
+                && a->getText().size() + b->getText().size() <= kMaxLiteral) {
+                parts.back() = makeLiteral(a->getText() + b->getText(), a->getFoldCase());
+                return;
+            }
+        }
+        parts.push_back(c);
+    };
+
+    for (auto& child : seq.getChildren()) {
+        NodePtr c = optimizeNode(child, foldCase);
+        // a sequence inside a sequence restores the same position on failure
+        if (c && c->kind() == NodeKind::Sequence) {
+            for (auto& cc : std::static_pointer_cast<SequenceNode>(c)->getChildren()) append(cc);
+        } else {
+            append(c);
+        }
+    }
+
+    if (parts.size() == 1 && parts[0]) return parts[0];
+    auto result = std::make_shared<SequenceNode>();
+    for (auto& p : parts) result->addChild(p);
+    return result;
+}
+
+/**
+ * An alternation is a list of alternatives tried in order; neighbouring
+ * single-byte alternatives can't both match at a position in different
+ * ways, so each run of them is merged into one class.
+ */
+static NodePtr optimizeOr(const OrNode& alt, bool foldCase) {
+    std::vector<NodePtr> options;
+    auto collect = [&](const NodePtr& c, auto& self) -> void {
+        if (c && c->kind() == NodeKind::Or) {
+            auto o = std::static_pointer_cast<OrNode>(c);
+            self(o->getLeft(), self);
+            self(o->getRight(), self);
+            return;
+        }
+        ByteSet set, prev;
+        if (!options.empty() && singleByte(c, set) && singleByte(options.back(), prev)) {
+            ByteSet merged = prev | set;
+            options.back() = merged.all() ? NodePtr(std::make_shared<DotNode>())
+                                          : NodePtr(std::make_shared<CharClassNode>(merged));
+            return;
+        }
+        options.push_back(c);
+    };
+    collect(optimizeNode(alt.getLeft(), foldCase), collect);
+    collect(optimizeNode(alt.getRight(), foldCase), collect);
+
+    // rebuilt left-nested, the way the parser builds a+b+c
+    NodePtr result = options[0];
+    for (size_t i = 1; i < options.size(); i++) {
+        result = std::make_shared<OrNode>(result, options[i]);
+    }
+    return result;
+}
+
+static NodePtr optimizeNode(const NodePtr& node, bool foldCase) {
+    if (!node) return node;
+
+    switch (node->kind()) {
+    case NodeKind::Character:
+        return makeLiteral(std::string(1, std::static_pointer_cast<CharacterNode>(node)->getChar()), foldCase);
+    case NodeKind::Dot:
+    case NodeKind::DotStar:
+    case NodeKind::OutputGroup:
+        return node;
+    case NodeKind::Sequence:
+        return optimizeSequence(*std::static_pointer_cast<SequenceNode>(node), foldCase);
+    case NodeKind::Or:
+        return optimizeOr(*std::static_pointer_cast<OrNode>(node), foldCase);
+    case NodeKind::Group: {
+        auto g = std::static_pointer_cast<GroupNode>(node);
+        return std::make_shared<GroupNode>(optimizeNode(g->getExpr(), foldCase), g->getGroupIndex());
+    }
+    case NodeKind::Star: {
+        NodePtr e = optimizeNode(std::static_pointer_cast<StarNode>(node)->getExpr(), foldCase);
+        if (e && e->kind() == NodeKind::Dot) return std::make_shared<DotStarNode>();
+        return std::make_shared<StarNode>(e);
+    }
+    case NodeKind::Count: {
+        auto cnt = std::static_pointer_cast<CountNode>(node);
+        NodePtr e = optimizeNode(cnt->getExpr(), foldCase);
+        int n = cnt->getCount();
+        if (n == 1) return e;
+        if (n > 1 && e && e->kind() == NodeKind::Literal) {
+            auto lit = std::static_pointer_cast<LiteralNode>(e);
+            if (lit->getText().size() * n <= kMaxLiteral) {
+                std::string text;
+                for (int i = 0; i < n; i++) text += lit->getText();
+                return makeLiteral(std::move(text), lit->getFoldCase());
+            }
+        }
+        return std::make_shared<CountNode>(e, n);
+    }
+    case NodeKind::IgnoreCase:
+        return optimizeNode(std::static_pointer_cast<IgnoreCaseNode>(node)->getExpr(), true);
+    case NodeKind::Literal: {
+        auto lit = std::static_pointer_cast<LiteralNode>(node);
+        if (!foldCase || lit->getFoldCase()) return node;
+        return makeLiteral(lit->getText(), true);
+    }
+    case NodeKind::CharClass:
+        if (!foldCase) return node;
+        return std::make_shared<CharClassNode>(std::static_pointer_cast<CharClassNode>(node)->getSet(true));
+    }
+    return node;
+}
+
+NodePtr optimizePattern(const NodePtr& ast) {
+    return optimizeNode(ast, false);
+}
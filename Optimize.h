@@ -0,0 +1,26 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <memory>
+#include "AST.h"
+
+/**
+ * Rewrites an AST produced by parsePattern() into an equivalent one that is
+ * cheaper to match and to compile:
+ *  - runs of characters become one LiteralNode ("Waterloo" is compared in
+ *    one go instead of eight CharacterNodes).
+ *  - c{N} (and literal{N}) is unrolled into a longer literal, x{1} into x.
+ *  - alternatives of single characters (a+b+c, also '.') become a
+ *    CharClassNode, so a+b+c is one set lookup instead of an OrNode chain.
+ *  - IgnoreCaseNode is resolved here: the characters below it become
+ *    case-folded literals and classes, so no node depends on
+ *    MatchContext::ignoreCase anymore.
+ *  - ".*" becomes a DotStarNode, which jumps straight to the end.
+ *  - nested sequences are flattened and one-child sequences unwrapped.
+ *
+ * The result matches exactly the same strings with the same captures and
+ * the same hitEnd behaviour. Groups are never touched.
+ */
+std::shared_ptr<ASTNode> optimizePattern(const std::shared_ptr<ASTNode>& ast);
+
+#endif // OPTIMIZE_H
@@ -0,0 +1,147 @@
+#include "Output.h"
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+static void writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        long n = (long)write(fd, data, (unsigned)size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return; // e.g. closed pipe, nothing sensible left to do
+        data += n;
+        size -= (size_t)n;
+    }
+}
+
+// head then tail, in one system call where there is writev.
+static void writeBoth(int fd, const char* head, size_t headSize, const char* tail, size_t tailSize) {
+#ifdef _WIN32
+    writeAll(fd, head, headSize);
+    writeAll(fd, tail, tailSize);
+#else
+    iovec parts[2] = {{(void*)head, headSize}, {(void*)tail, tailSize}};
+    iovec* next = headSize > 0 ? parts : parts + 1;
+    int count = headSize > 0 ? 2 : 1;
+    while (count > 0) {
+        long n = (long)writev(fd, next, count);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        // skip what was written, maybe part of a piece
+        while (count > 0 && (size_t)n >= next->iov_len) {
+            n -= (long)next->iov_len;
+            next++;
+            count--;
+        }
+        if (count > 0) {
+            next->iov_base = (char*)next->iov_base + n;
+            next->iov_len -= (size_t)n;
+        }
+    }
+#endif
+}
+
+// The background thread of an OutputBuffer and the block it is writing.
+struct OutputBuffer::Writer {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<char> block;
+    size_t size = 0;
+    bool busy = false;      // block is handed over and not written yet
+    bool stop = false;
+    std::thread thread;
+
+    void run(int fd) {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            changed.wait(guard, [&] { return busy || stop; });
+            if (!busy) return;
+            guard.unlock();
+            writeAll(fd, block.data(), size);
+            guard.lock();
+            busy = false;
+            changed.notify_all();
+        }
+    }
+
+    // Until the block handed over last is written.
+    void drain(std::unique_lock<std::mutex>& guard) {
+        changed.wait(guard, [&] { return !busy; });
+    }
+};
+
+OutputBuffer::OutputBuffer(int f, size_t capacity, bool background)
+    : fd(f), buffer(capacity) {
+    if (!background) return;
+    writer.reset(new Writer());
+    writer->block.resize(capacity);
+    writer->thread = std::thread([this] { writer->run(fd); });
+}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+    if (!writer) return;
+    {
+        std::unique_lock<std::mutex> guard(writer->lock);
+        writer->drain(guard);
+        writer->stop = true;
+        writer->changed.notify_all();
+    }
+    writer->thread.join();
+}
+
+void OutputBuffer::append(std::string_view text) {
+    if (used + text.size() > buffer.size()) {
+        // too big to be worth copying: write it straight through, after what is buffered
+        if (text.size() > buffer.size()) {
+            if (writer) {
+                std::unique_lock<std::mutex> guard(writer->lock);
+                writer->drain(guard);
+            }
+            writeBoth(fd, buffer.data(), used, text.data(), text.size());
+            used = 0;
+            return;
+        }
+        flush();
+    }
+    std::memcpy(buffer.data() + used, text.data(), text.size());
+    used += text.size();
+}
+
+void OutputBuffer::put(char c) {
+    if (used == buffer.size()) flush();
+    buffer[used++] = c;
+}
+
+void OutputBuffer::number(uint64_t n) {
+    char digits[20];
+    char* end = std::to_chars(digits, digits + sizeof digits, n).ptr;
+    append(std::string_view(digits, end - digits));
+}
+
+void OutputBuffer::flush() {
+    if (used == 0) return;
+    if (!writer) {
+        writeAll(fd, buffer.data(), used);
+        used = 0;
+        return;
+    }
+    // swap the full buffer with the one the writer is done with
+    std::unique_lock<std::mutex> guard(writer->lock);
+    writer->drain(guard);
+    buffer.swap(writer->block);
+    writer->size = used;
+    writer->busy = true;
+    writer->changed.notify_all();
+    used = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/**
+ * OutputBuffer
+ *  - collects output in a fixed-size buffer and writes it to a file
+ *    descriptor in large blocks, instead of flushing after every line.
+ *  - flushed when full and when destroyed. Text too big to be worth
+ *    copying goes out in the same write as what is buffered (writev), so
+ *    a huge match costs no copy and one system call.
+ *  - append() takes views, e.g. of a mapped input, and number() formats
+ *    in place, so writing a match allocates nothing.
+ *  - with background, a writer thread writes each full block while the
+ *    next one is filled (two buffers), so a slow reader of the output only
+ *    holds up matching once both are full. flush() then only hands the
+ *    block over; the destructor waits until everything is written.
+ */
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd = 1, size_t capacity = 64 * 1024, bool background = false);
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void append(std::string_view text);
+    void put(char c);
+    void number(uint64_t n);
+    void flush();
+
+private:
+    struct Writer;
+
+    int fd;
+    std::vector<char> buffer;
+    size_t used = 0;
+    std::unique_ptr<Writer> writer;
+};
+
+#endif // OUTPUT_H
@@ -0,0 +1,123 @@
+#include "Parallel.h"
+#include "Scan.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Below this a chunk isn't worth the hand-off.
+static const size_t kMinChunk = 1 << 20;
+// Chunks per worker, so uneven chunks still keep every worker busy.
+static const size_t kChunksPerWorker = 8;
+
+unsigned workerCount(unsigned requested) {
+    if (requested > 0) return requested;
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+size_t chunkSizeFor(size_t size, unsigned threads) {
+    return std::max(kMinChunk, size / (workerCount(threads) * kChunksPerWorker) + 1);
+}
+
+void runChunks(size_t count, unsigned threads,
+               const std::function<void(size_t, MatchScratch&)>& work,
+               const std::function<void(size_t)>& emit,
+               const MatchLimits& limits)
+{
+    threads = (unsigned)std::min<size_t>(workerCount(threads), count);
+    if (threads <= 1) {
+        MatchScratch scratch;
+        scratch.setLimits(limits);
+        for (size_t i = 0; i < count; i++) {
+            work(i, scratch);
+            emit(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::vector<char> done(count, 0);
+    std::mutex lock;
+    std::condition_variable finished;
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            MatchScratch scratch;
+            scratch.setLimits(limits);
+            for (size_t i = next++; i < count; i = next++) {
+                work(i, scratch);
+                std::lock_guard<std::mutex> guard(lock);
+                done[i] = 1;
+                finished.notify_one();
+            }
+        });
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            finished.wait(guard, [&] { return done[i] != 0; });
+        }
+        emit(i);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t findMatchParallel(const CompiledPattern& pattern, std::string_view text,
+                         MatchScratch& scratch, unsigned threads)
+{
+    scratch.prepare(pattern);
+    threads = workerCount(threads);
+    size_t chunk = chunkSizeFor(text.size(), threads);
+    if (threads <= 1 || text.size() <= chunk) {
+        return findMatch(pattern, text, scratch);
+    }
+
+    // The chunked searches leave the required literal to us (see findMatch).
+    const Literal& required = pattern.required();
+    if (findLiteral(text.data(), text.size(), required.text.data(), required.text.size(),
+                    required.foldCase) == std::string_view::npos) {
+        MATCH_STATS(scratch.counters.searches++; scratch.counters.literalRejects++);
+        return std::string_view::npos;
+    }
+
+    // chunk i covers the starts [i * chunk, (i + 1) * chunk), the last one up to text.size()
+    size_t count = text.size() / chunk + 1;
+    std::vector<size_t> found(count, std::string_view::npos);
+    std::vector<char> aborted(count, 0);
+    std::atomic<size_t> firstHit{count};
+    MATCH_STATS(std::vector<MatchStats> chunkStats(count));
+
+    runChunks(count, threads, [&](size_t i, MatchScratch& local) {
+        if (i > firstHit.load()) return; // an earlier chunk already has a match
+        size_t begin = i * chunk;
+        size_t last = std::min(text.size(), begin + chunk - 1);
+        MATCH_STATS(local.resetStats());
+        found[i] = findMatch(pattern, text, local, begin, last);
+        aborted[i] = local.aborted();
+        MATCH_STATS(chunkStats[i] = local.stats());
+        if (found[i] != std::string_view::npos) {
+            size_t seen = firstHit.load();
+            while (i < seen && !firstHit.compare_exchange_weak(seen, i)) {}
+        }
+    }, [](size_t) {}, scratch.limits());
+    MATCH_STATS(for (const MatchStats& s : chunkStats) scratch.counters.add(s));
+
+    // a chunk that gave up before the first match leaves the answer open
+    size_t hit = firstHit.load();
+    for (size_t i = 0; i < hit && i < count; i++) {
+        if (aborted[i]) {
+            scratch.budget.setExceeded();
+            return std::string_view::npos;
+        }
+    }
+    if (hit == count) return std::string_view::npos;
+    // redo the winning start with the caller's scratch to fill in its captures
+    return findMatch(pattern, text, scratch, found[hit], found[hit]);
+}
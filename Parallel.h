@@ -0,0 +1,44 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+#include <string_view>
+#include "Pattern.h"
+#include "Search.h"
+
+/**
+ * Multi-threaded search over one large in-memory input (e.g. a mapped file).
+ *  - the input is cut into chunks that are handed out in input order from a
+ *    shared counter, so a worker that finishes early just takes the next
+ *    chunk instead of idling on a fixed share.
+ *  - the CompiledPattern is shared; every worker has its own MatchScratch.
+ */
+
+// Number of workers to use for 'requested' threads (0 = one per core).
+unsigned workerCount(unsigned requested);
+
+// Chunk size for splitting 'size' bytes between 'threads' workers.
+size_t chunkSizeFor(size_t size, unsigned threads);
+
+/**
+ * Runs work(i, scratch) for every chunk i in [0, count) on 'threads' workers.
+ * emit(i) is called on the calling thread, in order, as soon as chunk i and
+ * all chunks before it are done, so results come out in input order while
+ * later chunks are still being searched. Every worker scratch gets 'limits'.
+ */
+void runChunks(size_t count, unsigned threads,
+               const std::function<void(size_t, MatchScratch&)>& work,
+               const std::function<void(size_t)>& emit,
+               const MatchLimits& limits = MatchLimits());
+
+/**
+ * Same result as findMatch(pattern, text, scratch): the chunks only split
+ * the candidate starts, and each match may run past the end of its chunk,
+ * so matches across chunk boundaries are found like any other. Chunks after
+ * one with a match are skipped. scratch.limits() apply to each chunk, and
+ * scratch.aborted() is set if a chunk that mattered ran over them.
+ */
+size_t findMatchParallel(const CompiledPattern& pattern, std::string_view text,
+                         MatchScratch& scratch, unsigned threads);
+
+#endif // PARALLEL_H
@@ -1,20 +1,49 @@
 #include "Parser.h"
 #include "Nodes.h"
-#include <cctype>
-#include <iostream>
+#include <climits>
+#include <cstdint>
 #include <optional>
 
 // We'll make a small, simple parser with recursive functions to illustrate.
 
-// A lightweight "cursor" struct:
+// Byte classes for the lexer: one table lookup decides what a pattern byte
+// can be, instead of searching a string of specials or calling <cctype>.
+enum : uint8_t {
+    kSpecial = 1,   // + * ( ) . { } and backslash: never a CHAR
+    kDigit = 2,
+    kSpace = 4,
+};
+
+struct LexTable {
+    uint8_t kind[256];
+};
+
+static constexpr LexTable makeLexTable() {
+    LexTable t{};
+    for (unsigned char c : {'+', '*', '(', ')', '.', '{', '}', '\\'}) t.kind[c] |= kSpecial;
+    for (int c = '0'; c <= '9'; c++) t.kind[c] |= kDigit;
+    for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) t.kind[c] |= kSpace;
+    return t;
+}
+
+static constexpr LexTable kLex = makeLexTable();
+
+static inline bool isKind(char c, uint8_t kind) { return (kLex.kind[(unsigned char)c] & kind) != 0; }
+
+// A lightweight "cursor" struct. It also carries all per-parse state, so
+// parsing is reentrant and patterns can be parsed concurrently.
 struct Cursor {
     const std::string& text;
     size_t pos;
-    Cursor(const std::string& t) : text(t), pos(0) {}
+    int groupCounter; // next capturing group index, group 0 is entire match
+    ParseError error; // the last thing that failed (what's reported if the whole parse fails)
+    bool failed;      // an error no other reading of the pattern gets around, e.g. a number too large
+    Cursor(const std::string& t) : text(t), pos(0), groupCounter(1), failed(false) {}
     bool end() const { return pos >= text.size(); }
     char current() const { return end() ? '\0' : text[pos]; }
     void advance() { if(!end()) pos++; }
     void retreat() { if(pos>0) pos--; }
+    void expected(const char* what) { error = ParseError{pos, what}; }
 };
 
 // Forward declarations of parse functions
@@ -27,7 +56,7 @@ static std::shared_ptr<ASTNode> parseIgnoreCase(std::shared_ptr<ASTNode> base, C
 
 // Helper to skip whitespace if needed (only if pattern can contain spaces)
 static void skipSpaces(Cursor& cur) {
-    while (!cur.end() && std::isspace(cur.current())) {
+    while (!cur.end() && isKind(cur.current(), kSpace)) {
         ++cur.pos;  // Directly advance instead of using cur.advance();
     }
 }
@@ -43,8 +72,59 @@ static bool matchChar(Cursor& cur, char c) {
     return false;
 }
 
+/**
+ * Reads the digits at the cursor into value, checking for overflow; returns
+ * how many there were. A number above INT_MAX fails the whole parse.
+ */
+static size_t parseNumber(Cursor& cur, int& value) {
+    size_t start = cur.pos;
+    long long n = 0;
+    while (!cur.end() && isKind(cur.current(), kDigit)) {
+        n = n * 10 + (cur.current() - '0');
+        if (n > INT_MAX) {
+            cur.error = ParseError{start, "number out of range"};
+            cur.failed = true;
+            return 0;
+        }
+        cur.advance();
+    }
+    value = (int)n;
+    return cur.pos - start;
+}
+
+/**
+ * Reads "{N}" at the cursor (which is at the '{') into value. A '{' without
+ * digits or without its '}' fails the whole parse, at the '{': no other
+ * reading of the pattern makes sense of a lone '{'.
+ */
+static bool parseBraces(Cursor& cur, int& value) {
+    size_t brace = cur.pos;
+    cur.advance();
+    size_t digits = parseNumber(cur, value);
+    if (cur.failed) return false;
+    if (digits == 0) {
+        cur.error = ParseError{brace, "expected a number after '{'"};
+    } else if (!matchChar(cur, '}')) {
+        cur.error = ParseError{brace, "missing '}'"};
+    } else {
+        return true;
+    }
+    cur.failed = true;
+    return false;
+}
+
 // parsePattern: top-level entry point
 std::shared_ptr<ASTNode> parsePattern(const std::string& pattern, int& outputGroupIndex) {
+    int groupCount = 0;
+    return parsePattern(pattern, outputGroupIndex, groupCount);
+}
+
+std::shared_ptr<ASTNode> parsePattern(const std::string& pattern, int& outputGroupIndex, int& groupCount) {
+    return parsePattern(pattern, outputGroupIndex, groupCount, nullptr);
+}
+
+std::shared_ptr<ASTNode> parsePattern(const std::string& pattern, int& outputGroupIndex, int& groupCount,
+                                      ParseError* error) {
     Cursor cur(pattern);
     //std::cout << "parsePattern() called\n";
 
@@ -52,26 +132,17 @@ std::shared_ptr<ASTNode> parsePattern(const std::string& pattern, int& outputGro
 
     // Now see if there's an \O{N} at the end
     // Check if we have "\O{"
-    if (!cur.end() && cur.current() == '\\') {
+    if (!cur.failed && !cur.end() && cur.current() == '\\') {
         size_t savedPos = cur.pos;
         cur.advance();
         if(!cur.end() && (cur.current() == 'O' || cur.current() == 'o')) {
             cur.advance();
             if(!cur.end() && cur.current() == '{') {
-                // parse a number
-                cur.advance();
-                // parse digits
-                std::string digits;
-                while(!cur.end() && std::isdigit(cur.current())) {
-                    digits.push_back(cur.current());
-                    cur.advance();
-                }
-                if(!digits.empty() && matchChar(cur, '}')) {
+                // parse the digits up to the '}'
+                int n = 0;
+                if (parseBraces(cur, n)) {
                     // we got \O{###}
-                    outputGroupIndex = std::stoi(digits);
-                } else {
-                    // revert
-                    cur.pos = savedPos; 
+                    outputGroupIndex = n;
                 }
             } else {
                 // revert
@@ -83,8 +154,20 @@ std::shared_ptr<ASTNode> parsePattern(const std::string& pattern, int& outputGro
         }
     }
 
-    // If the AST is null, might indicate parse failure. 
-    // In real code, you'd want robust error handling. 
+    // whatever is left is neither part of EXPR nor the \O{N} after it
+    if (ast && !cur.failed && !cur.end()) {
+        cur.error = ParseError{cur.pos, "unexpected character"};
+        cur.failed = true;
+    }
+
+    // groups are numbered 1..N, plus group 0 for the entire match
+    groupCount = cur.groupCounter;
+
+    // A null AST means the pattern doesn't parse; cur.error says where it failed.
+    if (cur.failed || !ast) {
+        if (error) *error = cur.error;
+        return nullptr;
+    }
     return ast;
 }
 
@@ -121,7 +204,7 @@ static std::shared_ptr<ASTNode> parseTerm(Cursor& cur) {
    // std::cout << "parseTerm() called\n";
 
     auto seq = std::make_shared<SequenceNode>();
-    while (true) {
+    while (!cur.failed) {
         auto f = parseFactor(cur);
         if (!f) {
             // ...
@@ -133,6 +216,9 @@ static std::shared_ptr<ASTNode> parseTerm(Cursor& cur) {
     // If sequence is empty, return nullptr, else return the node
     // We'll do a small hack to see if it has children. We'll try to dynamic_cast to SequenceNode.
     // A simpler approach: we can store them in a vector and check size.
+
+    // only after an error that fails the whole parse
+    return nullptr;
 }
 
 
@@ -181,7 +267,7 @@ static std::shared_ptr<ASTNode> parseFactor(Cursor& cur) {
     }
 
     // Handle single character if it's not a special one
-    if (!cur.end() && std::string("+*().{}\\").find(cur.current()) == std::string::npos) {
+    if (!cur.end() && !isKind(cur.current(), kSpecial)) {
         char c = cur.current();
         cur.advance();
 
@@ -203,6 +289,7 @@ static std::shared_ptr<ASTNode> parseFactor(Cursor& cur) {
         return base;
     }
 
+    cur.expected("expected a character, '.' or '('");
     return nullptr;
 }
 
@@ -211,15 +298,9 @@ static std::shared_ptr<ASTNode> parseFactor(Cursor& cur) {
 /**
  * parseGroup:
  *   '(' EXPR ')'
- *   We also treat each group as a capturing group. We'll store an incremental index for capturing.
- *   For simplicity, let's store them all in group index 0 for now, or we can do real indexing with
- *   a static counter. A robust approach would require more tracking.
+ *   We also treat each group as a capturing group. We'll store an incremental index for capturing,
+ *   taken from the cursor's groupCounter (so every parse starts again at group 1).
  */
-static int groupCounter = 1; // group 0 is entire match
-
-
-
-
 static std::shared_ptr<ASTNode> parseGroup(Cursor& cur) {
     // parse expression inside (...)
    // std::cout << "parseGroup() called\n";
@@ -227,13 +308,23 @@ static std::shared_ptr<ASTNode> parseGroup(Cursor& cur) {
     auto e = parseExpr(cur);
     //skipSpaces(cur);
 
+    // A '(' has no other reading: a body that doesn't parse (cur.error says
+    // where) or a missing ')' fails the whole parse.
+    if (cur.failed) return nullptr;
+    if (!e) {
+        cur.failed = true;
+        return nullptr;
+    }
+
     // We expect a ')'
     if (!matchChar(cur, ')')) {
+        cur.expected("missing ')'");
+        cur.failed = true;
         return nullptr;
     }
 
     // Build a GroupNode capturing into groupCounter
-    auto groupNode = std::make_shared<GroupNode>(e, groupCounter++);
+    auto groupNode = std::make_shared<GroupNode>(e, cur.groupCounter++);
     std::shared_ptr<ASTNode> base = groupNode;
 
     // Possibly parse {N} or * or \I after the group
@@ -265,19 +356,8 @@ static std::shared_ptr<ASTNode> parseCount(std::shared_ptr<ASTNode> base, Cursor
 
     // Check for '{N}'
     if (!cur.end() && cur.current() == '{') {
-        cur.advance();
-        // parse number
-        std::string digits;
-        while (!cur.end() && std::isdigit(cur.current())) {
-            digits.push_back(cur.current());
-            cur.advance();
-        }
-        if (!matchChar(cur, '}')) {
-            // parse error or no closing '}', skip or revert if you want robust code
-            return nullptr;
-        }
-        if (digits.empty()) return nullptr;
-        int n = std::stoi(digits);
+        int n = 0;
+        if (!parseBraces(cur, n)) return nullptr;
         return std::make_shared<CountNode>(base, n);
     }
     // No expansion
@@ -21,13 +21,43 @@
  *   ANY            = '.'
  *   CHAR           = any non-special character
  *   \I             = sets ignore-case mode
- *   {N}            = exact repetition
+ *   {N}            = exact repetition (N decimal, at most INT_MAX)
  *   +              = alternation
  *   \O{ number }   = indicates which capturing group to output
  *
+ * Special characters are + * ( ) . { } and the backslash; every other byte
+ * is a CHAR. The whole pattern has to parse: anything left after EXPR and
+ * its \O{N} is an error, and so is a '{' without a number and a '}', or a
+ * '(' without an EXPR and a ')'.
+ *
  * (You can refine or alter as needed.)
  */
 
 std::shared_ptr<ASTNode> parsePattern(const std::string& pattern, int& outputGroupIndex);
 
+/**
+ * Same as above, and also reports how many capture groups the pattern has,
+ * counting group 0 (the entire match), so capture storage can be sized up front.
+ * Parsing keeps no global state and is safe to call from several threads.
+ */
+std::shared_ptr<ASTNode> parsePattern(const std::string& pattern, int& outputGroupIndex, int& groupCount);
+
+/**
+ * Why a pattern doesn't parse: the offset in the pattern where parsing gave
+ * up and what it expected there (a static string).
+ */
+struct ParseError {
+    size_t position = 0;
+    const char* message = "";
+};
+
+/**
+ * Same as above; if the pattern doesn't parse, also fills in *error (when
+ * given). The lexer decides the class of each byte (special, digit, space)
+ * by table and reads numbers in place, and a number above INT_MAX is an
+ * error rather than an exception.
+ */
+std::shared_ptr<ASTNode> parsePattern(const std::string& pattern, int& outputGroupIndex, int& groupCount,
+                                      ParseError* error);
+
 #endif // PARSER_H
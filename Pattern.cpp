@@ -0,0 +1,162 @@
+#include "Pattern.h"
+#include "DFA.h"
+#include "Optimize.h"
+#include "Parser.h"
+#include "Scan.h"
+#include "Search.h"
+#include <algorithm>
+#include <atomic>
+
+static std::atomic<uint64_t> nextPatternId{1};
+
+// Only findMatch() with a group to fill in uses the one-pass form (see Plan.h).
+static std::optional<OnePass> onePassFor(const Program& prog, bool deterministic, int outputGroup) {
+    if (!deterministic || outputGroup == 0) return std::nullopt;
+    return OnePass::compile(prog);
+}
+
+static std::optional<Program> reverseFor(const Program& prog, const MatchPlan& plan) {
+    if (!plan.reverseSuffix) return std::nullopt;
+    return reverseProgram(prog);
+}
+
+CompiledPattern::CompiledPattern(std::string p, std::shared_ptr<ASTNode> tree, int outputGroup, int groupCount)
+    : uid(nextPatternId++), pattern(std::move(p)), ast(optimizePattern(tree)), output(outputGroup), groups(groupCount),
+      flat(flatten(ast)), prog(compileProgram(ast)), bits(ShiftAnd::compile(prog)), exact(isDeterministic(ast) && prog.exact),
+      tagged(onePassFor(prog, exact, output)), prefixLiteral(requiredPrefix(ast)), suffixLiteral(requiredSuffix(ast)),
+      requiredLit(requiredLiteral(ast)),
+      strategy(choosePlan(prog, shiftAnd(), onePass(), exact, output, prefixLiteral, suffixLiteral, requiredLit)),
+      backward(reverseFor(prog, strategy)) {}
+
+CompiledPattern::CompiledPattern(std::string p, int outputGroup, int groupCount, NodeArena arena, Program program,
+                                 bool deterministic, Literal prefix, Literal suffix, Literal required)
+    : uid(nextPatternId++), pattern(std::move(p)), output(outputGroup), groups(groupCount),
+      flat(std::move(arena)), prog(std::move(program)), bits(ShiftAnd::compile(prog)), exact(deterministic),
+      tagged(onePassFor(prog, exact, output)), prefixLiteral(std::move(prefix)), suffixLiteral(std::move(suffix)),
+      requiredLit(std::move(required)),
+      strategy(choosePlan(prog, shiftAnd(), onePass(), exact, output, prefixLiteral, suffixLiteral, requiredLit)),
+      backward(reverseFor(prog, strategy)) {}
+
+std::shared_ptr<const CompiledPattern> compilePattern(const std::string& pattern, ParseError* error) {
+    int outputGroup = 0; // default: group 0 = entire match
+    int groupCount = 1;
+    auto ast = parsePattern(pattern, outputGroup, groupCount, error);
+    if (!ast) return nullptr;
+    return std::make_shared<const CompiledPattern>(pattern, ast, outputGroup, groupCount);
+}
+
+bool CompiledPattern::find(std::string_view text, MatchScratch& scratch, size_t from) const {
+    return findMatch(*this, text, scratch, from) != std::string_view::npos;
+}
+
+bool CompiledPattern::matches(std::string_view text, MatchScratch& scratch) const {
+    // a literal is found as cheaply as it is detected
+    if (!exact || strategy.engine == MatchEngine::Literal) return find(text, scratch);
+
+    // the automaton's answer is exact, no need to locate the match
+    scratch.prepare(*this);
+    MATCH_STATS(MatchStats& stats = scratch.counters; stats.searches++; StatsTimer timer(stats.time));
+    if (findLiteral(text.data(), text.size(), requiredLit.text.data(), requiredLit.text.size(),
+                    requiredLit.foldCase) == std::string_view::npos) {
+        MATCH_STATS(stats.literalRejects++);
+        return false;
+    }
+    bool found;
+    if (bits) {
+        size_t end = bits->earliestEnd(text, 0, std::string_view::npos, &scratch.budget);
+        MATCH_STATS(stats.dfaBytes += std::min(end, text.size()));
+        found = end != std::string_view::npos;
+    } else {
+        found = scratch.unanchoredDFA().matches(text);
+    }
+    MATCH_STATS(if (found) stats.matches++);
+    return found;
+}
+
+// Average record length from which matchesBatch() prefers the DFA lanes to a cyclic ShiftAnd.
+static const size_t kMinLaneLength = 32;
+
+size_t CompiledPattern::matchesBatch(const RecordBatch& batch, MatchScratch& scratch, std::vector<char>& matched,
+                                     bool* aborted) const {
+    if (aborted) *aborted = false;
+    matched.assign(batch.size(), 0);
+    scratch.prepare(*this);
+    std::vector<size_t>& records = scratch.batchRecords;
+    records.clear();
+    {
+        MATCH_STATS(MatchStats& stats = scratch.counters; stats.searches += batch.size(); StatsTimer timer(stats.time));
+        // one scan for the required literal over all records, which are in order
+        const std::string& lit = requiredLit.text;
+        if (lit.empty()) {
+            records.resize(batch.size());
+            for (size_t k = 0; k < batch.size(); k++) records[k] = k;
+        } else {
+            size_t last = batch.size() ? batch.offsets.back() + batch.lengths.back() : 0;
+            size_t hit = std::string_view::npos;   // next occurrence, once looked up
+            for (size_t k = 0; k < batch.size(); k++) {
+                size_t begin = batch.offsets[k], end = begin + batch.lengths[k];
+                if (hit == std::string_view::npos || hit < begin) {
+                    hit = findLiteral(batch.data.data() + begin, last - begin, lit.data(), lit.size(),
+                                      requiredLit.foldCase);
+                    if (hit == std::string_view::npos) break;
+                    hit += begin;
+                }
+                if (hit + lit.size() <= end) records.push_back(k);
+            }
+        }
+        MATCH_STATS(stats.literalRejects += batch.size() - records.size());
+        size_t bytes = 0;
+        for (size_t k : records) bytes += batch.lengths[k];
+        if (bits && (bits->acyclic() || bytes < records.size() * kMinLaneLength)) {
+            // a few word operations per byte: no slower than a lane of the DFA
+            // without loops, and without the rounds cut short by short records
+            for (size_t k : records) {
+                scratch.budget.start();
+                matched[k] = bits->earliestEnd(batch.record(k), 0, std::string_view::npos, &scratch.budget) !=
+                             std::string_view::npos;
+                if (aborted && scratch.aborted()) *aborted = true;
+            }
+        } else {
+            scratch.unanchoredDFA().matchesBatch(batch, records, matched);
+            if (aborted && scratch.aborted()) *aborted = true;
+        }
+    }
+
+    size_t count = 0;
+    for (size_t k : records) {
+        if (!matched[k]) continue;
+        // the automaton only rules records out, the tree matcher decides
+        if (!exact) {
+            matched[k] = find(batch.record(k), scratch);
+            if (aborted && scratch.aborted()) *aborted = true;
+        }
+        count += matched[k];
+    }
+    MATCH_STATS(if (exact) scratch.counters.matches += count);
+    return count;
+}
+
+size_t CompiledPattern::findAll(std::string_view text, MatchScratch& scratch,
+                                const std::function<bool(const MatchScratch&)>& onMatch) const {
+    size_t count = 0;
+    MatchIterator it(*this, text, scratch);
+    while (it.next()) {
+        count++;
+        if (!onMatch(scratch)) break;
+    }
+    return count;
+}
+
+std::optional<std::string_view> CompiledPattern::find(std::string_view text) const {
+    static thread_local MatchScratch scratch;
+    if (!find(text, scratch)) return std::nullopt;
+
+    const auto& caps = scratch.captures();
+    if (output >= (int)caps.size() || !caps[output].has_value()) return std::string_view();
+    return text.substr(caps[output]->startIndex, caps[output]->endIndex - caps[output]->startIndex);
+}
+
+bool CompiledPattern::matches(std::string_view text) const {
+    static thread_local MatchScratch scratch;
+    return matches(text, scratch);
+}
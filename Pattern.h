@@ -0,0 +1,128 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AST.h"
+#include "Analysis.h"
+#include "Arena.h"
+#include "Batch.h"
+#include "OnePass.h"
+#include "Plan.h"
+#include "Program.h"
+#include "ShiftAnd.h"
+
+class MatchScratch;
+struct ParseError;
+
+/**
+ * CompiledPattern
+ *  - everything derived from one pattern string: the AST, its flat form,
+ *    the automaton Program (and its ShiftAnd form when it is small enough,
+ *    its OnePass form when groups are asked for and it is one-pass) and the
+ *    results of the analysis passes.
+ *  - immutable once built, so one instance can be shared between threads;
+ *    all mutable matching state lives in a MatchScratch (see Search.h).
+ *  - build it once with compilePattern() and call find() / findAll() /
+ *    matches() on as many inputs as needed.
+ */
+class CompiledPattern {
+public:
+    CompiledPattern(std::string pattern, std::shared_ptr<ASTNode> ast, int outputGroup, int groupCount);
+
+    // From the parts of a compiled pattern, e.g. read back by loadPatterns()
+    // (PatternFile.h); tree() is then null.
+    CompiledPattern(std::string pattern, int outputGroup, int groupCount, NodeArena flat, Program prog,
+                    bool deterministic, Literal prefix, Literal suffix, Literal required);
+
+    // Leftmost match starting at or after 'from'; captures in scratch.captures().
+    bool find(std::string_view text, MatchScratch& scratch, size_t from = 0) const;
+
+    // Is there a match anywhere in text? Cheaper than find() when the
+    // automaton alone can answer.
+    bool matches(std::string_view text, MatchScratch& scratch) const;
+
+    /**
+     * Reports every non-overlapping match from left to right (see
+     * MatchIterator). onMatch sees the captures in the scratch and returns
+     * false to stop early.
+     * Returns the number of matches reported.
+     */
+    size_t findAll(std::string_view text, MatchScratch& scratch,
+                   const std::function<bool(const MatchScratch&)>& onMatch) const;
+
+    /**
+     * matched[k] = matches(batch.record(k), scratch) for every record of the
+     * batch (see Batch.h), for many short records at a time: the required
+     * literal is looked up once over the whole buffer, and the records it
+     * leaves run through the DFA side by side. Returns the number of
+     * matching records. If a record's search runs over the limits it counts
+     * as not matching and *aborted (if given) is set.
+     */
+    size_t matchesBatch(const RecordBatch& batch, MatchScratch& scratch, std::vector<char>& matched,
+                        bool* aborted = nullptr) const;
+
+    // Convenience versions using a per-thread scratch. find() returns the
+    // text of the output group (empty view if that group didn't take part).
+    std::optional<std::string_view> find(std::string_view text) const;
+    bool matches(std::string_view text) const;
+
+    // Unique per instance, also across instances reusing the same address.
+    uint64_t id() const { return uid; }
+
+    const std::string& source() const { return pattern; }
+    const std::shared_ptr<ASTNode>& tree() const { return ast; }   // null if loaded
+    const NodeArena& arena() const { return flat; }
+    const Program& program() const { return prog; }
+    // The bit-parallel form of program(), null if it has too many positions.
+    const ShiftAnd* shiftAnd() const { return bits ? &*bits : nullptr; }
+    // The one-pass form of program(), null unless the pattern is deterministic,
+    // has \O{N} with N > 0 and its Program is one-pass.
+    const OnePass* onePass() const { return tagged ? &*tagged : nullptr; }
+    // reverseProgram() of program(), null unless the plan searches backwards from suffix().
+    const Program* reversed() const { return backward ? &*backward : nullptr; }
+
+    // Group requested with \O{N} (0 = entire match).
+    int outputGroup() const { return output; }
+    // Number of capture groups, counting group 0.
+    int groupCount() const { return groups; }
+
+    // See isDeterministic() in Analysis.h.
+    bool deterministic() const { return exact; }
+    const Literal& prefix() const { return prefixLiteral; }
+    const Literal& suffix() const { return suffixLiteral; }
+    const Literal& required() const { return requiredLit; }
+
+    // How findMatch() goes about it, see Plan.h.
+    const MatchPlan& plan() const { return strategy; }
+
+private:
+    uint64_t uid;
+    std::string pattern;
+    std::shared_ptr<ASTNode> ast;
+    int output;
+    int groups;
+    NodeArena flat;
+    Program prog;
+    std::optional<ShiftAnd> bits;
+    bool exact;
+    std::optional<OnePass> tagged;
+    Literal prefixLiteral;
+    Literal suffixLiteral;
+    Literal requiredLit;
+    MatchPlan strategy;
+    std::optional<Program> backward;
+};
+
+/**
+ * Parse and compile a pattern. Returns nullptr if the pattern can't be parsed,
+ * and then says why in *error if given (see Parser.h).
+ */
+std::shared_ptr<const CompiledPattern> compilePattern(const std::string& pattern, ParseError* error = nullptr);
+
+#endif // PATTERN_H
@@ -0,0 +1,59 @@
+#include "PatternCache.h"
+#include <functional>
+
+PatternCache::PatternCache(size_t capacity, size_t shardCount)
+    : shards(shardCount > 0 ? shardCount : 1),
+      perShard((capacity + shards.size() - 1) / shards.size()) {}
+
+PatternCache::Shard& PatternCache::shardFor(std::string_view pattern) {
+    return shards[std::hash<std::string_view>()(pattern) % shards.size()];
+}
+
+std::shared_ptr<const CompiledPattern> PatternCache::get(std::string_view pattern) {
+    Shard& shard = shardFor(pattern);
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto it = shard.index.find(pattern);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            hitCount.fetch_add(1, std::memory_order_relaxed);
+            return it->second->compiled;
+        }
+    }
+
+    missCount.fetch_add(1, std::memory_order_relaxed);
+    auto compiled = compilePattern(std::string(pattern));
+    if (!compiled || perShard == 0) return compiled;
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.index.find(pattern);
+    if (it != shard.index.end()) {
+        // another thread compiled it meanwhile; keep one copy
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return it->second->compiled;
+    }
+    shard.lru.push_front(Entry{std::string(pattern), compiled});
+    shard.index.emplace(shard.lru.front().pattern, shard.lru.begin());
+    if (shard.lru.size() > perShard) {
+        shard.index.erase(shard.lru.back().pattern);
+        shard.lru.pop_back();
+    }
+    return compiled;
+}
+
+size_t PatternCache::size() const {
+    size_t n = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        n += shard.lru.size();
+    }
+    return n;
+}
+
+void PatternCache::clear() {
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.index.clear();
+        shard.lru.clear();
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef PATTERN_CACHE_H
+#define PATTERN_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Pattern.h"
+
+/**
+ * PatternCache
+ *  - compiled patterns by pattern text, for callers that see the same
+ *    patterns over and over: get() hands out the CompiledPattern built the
+ *    first time and only parses and compiles on a miss.
+ *  - bounded: each shard drops its least recently used pattern once it
+ *    holds capacity / shards of them. Dropped patterns stay valid for as
+ *    long as a caller still holds them.
+ *  - thread-safe: the patterns are spread over shards by hash, each with a
+ *    lock of its own, so threads only contend when they look up patterns
+ *    of the same shard. Compiling happens outside the lock.
+ *  - the DFA states stay in each thread's MatchScratch (see Search.h),
+ *    which has its own memory budget; the cached patterns are immutable.
+ *  - patterns that don't parse aren't cached (get() returns nullptr).
+ */
+class PatternCache {
+public:
+    explicit PatternCache(size_t capacity = 4096, size_t shards = 16);
+
+    // The compiled pattern, from the cache or compiled now; nullptr if it can't be parsed.
+    std::shared_ptr<const CompiledPattern> get(std::string_view pattern);
+
+    // Patterns currently cached.
+    size_t size() const;
+    void clear();
+
+    // Lookups answered from the cache / that had to compile.
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        std::string pattern;
+        std::shared_ptr<const CompiledPattern> compiled;
+    };
+    // most recently used first; the index keys point into the list entries
+    struct Shard {
+        mutable std::mutex lock;
+        std::list<Entry> lru;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    };
+
+    std::vector<Shard> shards;
+    size_t perShard;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+
+    Shard& shardFor(std::string_view pattern);
+};
+
+#endif // PATTERN_CACHE_H
@@ -0,0 +1,325 @@
+#include "PatternFile.h"
+#include "Fold.h"
+#include "Input.h"
+#include <cstring>
+#include <fstream>
+
+static const char kMagic[8] = {'S', 'P', 'P', 'A', 'T', 'T', 'R', 'N'};
+static const uint32_t kByteOrder = 0x01020304;
+
+// Fixed-size records, in native byte order (the header says which).
+static const size_t kNodeSize = 16;
+static const size_t kInstructionSize = 12;
+static const size_t kSetSize = 32;
+
+struct PatternWriter {
+    std::string out;
+
+    void u8(uint8_t v) { out.push_back((char)v); }
+    void u32(uint32_t v) { out.append((const char*)&v, sizeof v); }
+    void i32(int32_t v) { out.append((const char*)&v, sizeof v); }
+    void u64(uint64_t v) { out.append((const char*)&v, sizeof v); }
+    void bytes(std::string_view s) {
+        u32((uint32_t)s.size());
+        out.append(s.data(), s.size());
+    }
+    void literal(const Literal& lit) {
+        bytes(lit.text);
+        u8(lit.foldCase);
+    }
+    void sets(const std::vector<ByteSet>& sets) {
+        u32((uint32_t)sets.size());
+        for (const ByteSet& set : sets) {
+            for (int i = 0; i < 256; i += 8) {
+                uint8_t byte = 0;
+                for (int k = 0; k < 8; k++) byte |= set[i + k] << k;
+                u8(byte);
+            }
+        }
+    }
+};
+
+// Reads past the end or of impossible sizes leave ok == false.
+struct PatternReader {
+    std::string_view data;
+    size_t pos = 0;
+    bool ok = true;
+
+    bool take(void* to, size_t n) {
+        if (!ok || data.size() - pos < n) return ok = false;
+        std::memcpy(to, data.data() + pos, n);
+        pos += n;
+        return true;
+    }
+    uint8_t u8() { uint8_t v = 0; take(&v, 1); return v; }
+    uint32_t u32() { uint32_t v = 0; take(&v, sizeof v); return v; }
+    int32_t i32() { int32_t v = 0; take(&v, sizeof v); return v; }
+    uint64_t u64() { uint64_t v = 0; take(&v, sizeof v); return v; }
+    // A record count, checked against what is left before anything is allocated.
+    size_t count(size_t recordSize) {
+        size_t n = u32();
+        if (ok && n > (data.size() - pos) / recordSize) ok = false;
+        return ok ? n : 0;
+    }
+    std::string bytes() {
+        size_t n = count(1);
+        std::string s(data.substr(pos, n));
+        pos += n;
+        return s;
+    }
+    Literal literal() {
+        Literal lit;
+        lit.text = bytes();
+        lit.foldCase = u8() != 0;
+        return lit;
+    }
+    std::vector<ByteSet> sets() {
+        std::vector<ByteSet> sets(count(kSetSize));
+        for (ByteSet& set : sets) {
+            for (int i = 0; i < 256; i += 8) {
+                uint8_t byte = u8();
+                for (int k = 0; k < 8; k++) set[i + k] = (byte >> k) & 1;
+            }
+        }
+        return sets;
+    }
+};
+
+static void writeArena(PatternWriter& w, const NodeArena& arena) {
+    w.u32((uint32_t)arena.nodes.size());
+    for (const FlatNode& node : arena.nodes) {
+        w.u8((uint8_t)node.kind);
+        w.u8(node.foldCase);
+        w.u8(node.ch);
+        w.u8(0);
+        w.i32(node.a);
+        w.i32(node.b);
+        w.i32(node.memo);
+    }
+    w.u32((uint32_t)arena.children.size());
+    for (int32_t c : arena.children) w.i32(c);
+    w.bytes(arena.text);
+    w.sets(arena.classes);
+    w.i32(arena.root);
+    w.i32(arena.memoSlots);
+}
+
+static void writeProgram(PatternWriter& w, const Program& prog) {
+    w.u32((uint32_t)prog.code.size());
+    for (const Instruction& inst : prog.code) {
+        w.u8((uint8_t)inst.op);
+        w.u8(inst.ch);
+        w.u8(inst.foldCase);
+        w.u8(0);
+        w.i32(inst.x);
+        w.i32(inst.y);
+    }
+    w.i32(prog.start);
+    w.i32(prog.slotCount);
+    w.sets(prog.classes);
+}
+
+// Folded characters are stored as lowercase letters (the matchers only lower the input).
+static bool foldedChar(unsigned char ch, bool foldCase) {
+    return !foldCase || (hasOtherCase(ch) && foldLower(ch) == ch);
+}
+
+static bool readArena(PatternReader& r, NodeArena& arena, int groups) {
+    arena.nodes.resize(r.count(kNodeSize));
+    for (FlatNode& node : arena.nodes) {
+        node.kind = (NodeKind)r.u8();
+        node.foldCase = r.u8() != 0;
+        node.ch = r.u8();
+        r.u8();
+        node.a = r.i32();
+        node.b = r.i32();
+        node.memo = r.i32();
+    }
+    arena.children.resize(r.count(sizeof(int32_t)));
+    for (int32_t& c : arena.children) c = r.i32();
+    arena.text = r.bytes();
+    arena.classes = r.sets();
+    arena.root = r.i32();
+    arena.memoSlots = r.i32();
+    if (!r.ok) return false;
+
+    // children come before their parents, -1 is an empty subexpression
+    int32_t n = (int32_t)arena.nodes.size();
+    auto child = [](int32_t c, int32_t parent) { return c >= -1 && c < parent; };
+    if (arena.root < -1 || arena.root >= n || arena.memoSlots < 0 || arena.memoSlots > n) return false;
+    for (int32_t i = 0; i < n; i++) {
+        const FlatNode& node = arena.nodes[i];
+        if (node.memo < -1 || node.memo >= arena.memoSlots) return false;
+        switch (node.kind) {
+        case NodeKind::Character:
+            if (!foldedChar(node.ch, node.foldCase)) return false;
+            break;
+        case NodeKind::Dot:
+        case NodeKind::DotStar:
+            break;
+        case NodeKind::Literal:
+            if (node.a < 0 || node.b < 0 || (size_t)node.a + node.b > arena.text.size()) return false;
+            break;
+        case NodeKind::CharClass:
+            if (node.a < 0 || (size_t)node.a >= arena.classes.size()) return false;
+            break;
+        case NodeKind::Sequence:
+            if (node.a < 0 || node.b < 0 || (size_t)node.a + node.b > arena.children.size()) return false;
+            for (int32_t k = 0; k < node.b; k++) {
+                if (!child(arena.children[node.a + k], i)) return false;
+            }
+            break;
+        case NodeKind::Or:
+            if (!child(node.a, i) || !child(node.b, i)) return false;
+            break;
+        case NodeKind::Group:
+            if (!child(node.a, i) || node.b < 0 || node.b >= groups) return false;
+            break;
+        case NodeKind::Star:
+            if (!child(node.a, i)) return false;
+            break;
+        case NodeKind::Count:
+            if (!child(node.a, i) || node.b < 0) return false;
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool readProgram(PatternReader& r, Program& prog, int groups) {
+    prog.code.resize(r.count(kInstructionSize));
+    for (Instruction& inst : prog.code) {
+        inst.op = (OpCode)r.u8();
+        inst.ch = r.u8();
+        inst.foldCase = r.u8() != 0;
+        r.u8();
+        inst.x = r.i32();
+        inst.y = r.i32();
+    }
+    prog.start = r.i32();
+    prog.slotCount = r.i32();
+    prog.classes = r.sets();
+    if (!r.ok) return false;
+
+    int n = (int)prog.code.size();
+    auto target = [n](int pc) { return pc >= 0 && pc < n; };
+    if (!target(prog.start) || prog.slotCount < 0 || prog.slotCount > 2 * groups) return false;
+    // the code goes on after every instruction but Split, Jump and the one Match
+    int matches = 0;
+    for (int pc = 0; pc < n; pc++) {
+        const Instruction& inst = prog.code[pc];
+        bool last = pc + 1 == n;
+        switch (inst.op) {
+        case OpCode::Char:
+            if (last || !foldedChar(inst.ch, inst.foldCase)) return false;
+            break;
+        case OpCode::Any:
+            if (last) return false;
+            break;
+        case OpCode::Match:
+            matches++;
+            break;
+        case OpCode::Class:
+            if (last || inst.x < 0 || (size_t)inst.x >= prog.classes.size()) return false;
+            break;
+        case OpCode::Split:
+            if (!target(inst.x) || !target(inst.y)) return false;
+            break;
+        case OpCode::Jump:
+            if (!target(inst.x)) return false;
+            break;
+        case OpCode::Save:
+            if (last || inst.x < 0 || inst.x >= prog.slotCount) return false;
+            break;
+        default:
+            return false;
+        }
+    }
+    return matches == 1;
+}
+
+std::string serializePatterns(const std::vector<SavedPattern>& patterns) {
+    PatternWriter w;
+    w.out.append(kMagic, sizeof kMagic);
+    w.u32(kPatternFileVersion);
+    w.u32(kByteOrder);
+    w.u32((uint32_t)patterns.size());
+    for (const SavedPattern& saved : patterns) {
+        const CompiledPattern& p = *saved.pattern;
+        w.u64(saved.tag);
+        w.bytes(p.source());
+        w.i32(p.outputGroup());
+        w.i32(p.groupCount());
+        w.u8(p.deterministic());
+        w.literal(p.prefix());
+        w.literal(p.suffix());
+        w.literal(p.required());
+        writeArena(w, p.arena());
+        writeProgram(w, p.program());
+    }
+    return std::move(w.out);
+}
+
+bool isPatternFile(std::string_view data) {
+    return data.size() >= sizeof kMagic && std::memcmp(data.data(), kMagic, sizeof kMagic) == 0;
+}
+
+bool deserializePatterns(std::string_view data, std::vector<SavedPattern>& patterns, std::string* error) {
+    auto fail = [&](const char* why) {
+        if (error) *error = why;
+        patterns.clear();
+        return false;
+    };
+    patterns.clear();
+    if (!isPatternFile(data)) return fail("not a compiled pattern file");
+    PatternReader r { data, sizeof kMagic };
+    if (r.u32() != kPatternFileVersion) return fail("written by another version, compile the patterns again");
+    if (r.u32() != kByteOrder) return fail("written on a machine of another byte order");
+
+    // every pattern takes more than 64 bytes, so this bounds the reserve
+    size_t count = r.count(64);
+    patterns.reserve(count);
+    for (size_t i = 0; i < count && r.ok; i++) {
+        SavedPattern saved;
+        saved.tag = r.u64();
+        std::string source = r.bytes();
+        int output = r.i32();
+        int groups = r.i32();
+        bool exact = r.u8() != 0;
+        Literal prefix = r.literal();
+        Literal suffix = r.literal();
+        Literal required = r.literal();
+        NodeArena arena;
+        Program prog;
+        // every group takes "()" in the source
+        bool sane = output >= 0 && groups >= 1 && (size_t)groups <= source.size() / 2 + 1;
+        if (!r.ok || !sane || !readArena(r, arena, groups) || !readProgram(r, prog, groups)) {
+            return fail("damaged compiled pattern file");
+        }
+        saved.pattern = std::make_shared<const CompiledPattern>(
+            std::move(source), output, groups, std::move(arena), std::move(prog), exact,
+            std::move(prefix), std::move(suffix), std::move(required));
+        patterns.push_back(std::move(saved));
+    }
+    if (!r.ok || r.pos != data.size()) return fail("damaged compiled pattern file");
+    return true;
+}
+
+bool savePatterns(const std::string& path, const std::vector<SavedPattern>& patterns) {
+    std::string data = serializePatterns(patterns);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), (std::streamsize)data.size());
+    out.close();
+    return !out.fail();
+}
+
+bool loadPatterns(const std::string& path, std::vector<SavedPattern>& patterns, std::string* error) {
+    MappedFile file(path);
+    if (!file.ok()) {
+        if (error) *error = "cannot read " + path;
+        return false;
+    }
+    return deserializePatterns(file.view(), patterns, error);
+}
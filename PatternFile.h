@@ -0,0 +1,52 @@
+#ifndef PATTERN_FILE_H
+#define PATTERN_FILE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Pattern.h"
+
+/**
+ * Compiled patterns on disk, so a large rule set doesn't have to be parsed,
+ * optimized and analysed again at every start.
+ *
+ *  - a file holds the compiled form of each pattern (the NodeArena, the
+ *    Program, the prefilter literals, the group count and output group)
+ *    together with its source text and a caller-chosen tag (match stores
+ *    the line of the rule).
+ *  - the header carries a magic, kPatternFileVersion and the byte order;
+ *    files written by another version or on another byte order are
+ *    rejected, and so is anything truncated or with indices out of range,
+ *    so a bad file can't make the matchers read out of bounds.
+ *  - loading maps the file and decodes each array in a single pass; no
+ *    pattern is parsed, optimized or analysed. Loaded patterns have no
+ *    tree() (it is only needed to compile them).
+ */
+
+// Bumped whenever the layout or the meaning of a serialized field changes
+// (e.g. a new NodeKind or OpCode, or a change to what the optimizer emits).
+static const uint32_t kPatternFileVersion = 3;
+
+struct SavedPattern {
+    std::shared_ptr<const CompiledPattern> pattern;
+    uint64_t tag = 0;
+};
+
+// The file contents for 'patterns'.
+std::string serializePatterns(const std::vector<SavedPattern>& patterns);
+
+// Decodes serializePatterns() output into 'patterns'; false (and a reason in
+// *error, if given) if the data is stale or damaged.
+bool deserializePatterns(std::string_view data, std::vector<SavedPattern>& patterns,
+                         std::string* error = nullptr);
+
+// True if data starts like a pattern file (of any version).
+bool isPatternFile(std::string_view data);
+
+bool savePatterns(const std::string& path, const std::vector<SavedPattern>& patterns);
+bool loadPatterns(const std::string& path, std::vector<SavedPattern>& patterns,
+                  std::string* error = nullptr);
+
+#endif // PATTERN_FILE_H
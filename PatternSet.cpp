@@ -0,0 +1,106 @@
+#include "PatternSet.h"
+#include <atomic>
+
+static std::atomic<uint64_t> nextSetId{1};
+
+static Program combineAll(const std::vector<std::shared_ptr<const CompiledPattern>>& patterns) {
+    if (patterns.empty()) return Program();
+    std::vector<const Program*> programs;
+    for (auto& p : patterns) programs.push_back(&p->program());
+    return combinePrograms(programs);
+}
+
+static std::vector<Literal> requiredLiterals(const std::vector<std::shared_ptr<const CompiledPattern>>& patterns) {
+    std::vector<Literal> literals;
+    for (auto& p : patterns) literals.push_back(p->required());
+    return literals;
+}
+
+PatternSet::PatternSet(std::vector<std::shared_ptr<const CompiledPattern>> ps)
+    : uid(nextSetId++), patterns(std::move(ps)), combined(combineAll(patterns)),
+      literals(requiredLiterals(patterns))
+{
+    for (auto& p : patterns) {
+        if (p->required().text.empty()) filtered = false;
+    }
+}
+
+void PatternSetScratch::prepare(const PatternSet& set) {
+    over = false;
+    if (bound == set.id()) return;
+    // keep the counts of the scratches about to be dropped
+    counters = stats();
+    dfaBytesBefore = 0;
+    bound = set.id();
+    dfa.reset();
+    if (set.size() > 0) dfa.emplace(set.program(), false);
+    searches.clear();
+    searches.resize(set.size());
+    found.assign(set.size(), 0);
+    matched.assign(set.size(), 0);
+}
+
+MatchStats PatternSetScratch::stats() const {
+    MatchStats r = counters;
+    for (const MatchScratch& s : searches) {
+        // the confirming searches ran inside matchAll(), already counted
+        MatchStats inner = s.stats();
+        inner.searches = 0;
+        inner.time = std::chrono::nanoseconds(0);
+        r.add(inner);
+    }
+    if (dfa) r.dfaBytes += dfa->bytesScanned() - dfaBytesBefore;
+    return r;
+}
+
+void PatternSetScratch::resetStats() {
+    counters = MatchStats();
+    for (MatchScratch& s : searches) s.resetStats();
+    dfaBytesBefore = dfa ? dfa->bytesScanned() : 0;
+}
+
+void PatternSet::matchAll(std::string_view text, PatternSetScratch& scratch, std::vector<size_t>& ids) const {
+    ids.clear();
+    scratch.prepare(*this);
+    if (patterns.empty()) return;
+    MATCH_STATS(scratch.counters.searches++; StatsTimer timer(scratch.counters.time));
+
+    std::fill(scratch.found.begin(), scratch.found.end(), 0);
+    if (filtered && literals.find(text, scratch.found) == 0) {
+        MATCH_STATS(scratch.counters.literalRejects++);
+        return;
+    }
+
+    std::fill(scratch.matched.begin(), scratch.matched.end(), 0);
+    scratch.dfa->matchingPrograms(text, scratch.matched);
+
+    for (size_t i = 0; i < patterns.size(); i++) {
+        if (!scratch.matched[i]) continue;
+        // the Program match contains the literal anyway; this just skips
+        // the confirming search when the literal scan already ruled it out
+        if (filtered && !scratch.found[i]) continue;
+        const CompiledPattern& p = *patterns[i];
+        if (!p.deterministic()) {
+            MatchScratch& search = scratch.searches[i];
+            search.setLimits(scratch.limits);
+            if (!p.matches(text, search)) {
+                scratch.over = scratch.over || search.aborted();
+                continue;
+            }
+        }
+        ids.push_back(i);
+    }
+}
+
+std::shared_ptr<const PatternSet> compilePatternSet(const std::vector<std::string>& patterns, size_t* failed) {
+    std::vector<std::shared_ptr<const CompiledPattern>> compiled;
+    for (size_t i = 0; i < patterns.size(); i++) {
+        auto p = compilePattern(patterns[i]);
+        if (!p) {
+            if (failed) *failed = i;
+            return nullptr;
+        }
+        compiled.push_back(std::move(p));
+    }
+    return std::make_shared<const PatternSet>(std::move(compiled));
+}
@@ -0,0 +1,102 @@
+#ifndef PATTERN_SET_H
+#define PATTERN_SET_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Budget.h"
+#include "DFA.h"
+#include "LiteralSet.h"
+#include "Pattern.h"
+#include "Program.h"
+#include "Search.h"
+
+class PatternSetScratch;
+
+/**
+ * PatternSet
+ *  - many patterns compiled together, to find out which of them match a
+ *    text in one pass instead of one search per pattern.
+ *  - the required literals of the patterns (see requiredLiteral()) go into
+ *    one Aho-Corasick automaton (LiteralSet.h). If every pattern has one, a
+ *    text containing none of them is rejected after that single scan.
+ *  - the Programs of all patterns are combined into one (combinePrograms())
+ *    and run as a single lazy DFA, which reports every pattern with a
+ *    Program match. For deterministic patterns (isDeterministic()) that is
+ *    the answer; the others are confirmed with a search of their own.
+ *  - immutable and shareable between threads like CompiledPattern; all
+ *    mutable state lives in a PatternSetScratch.
+ */
+class PatternSet {
+public:
+    explicit PatternSet(std::vector<std::shared_ptr<const CompiledPattern>> patterns);
+
+    /**
+     * Indices of the patterns that match somewhere in text, in increasing
+     * order, into 'ids' (cleared first). A pattern whose confirming search
+     * ran over scratch.limits() is left out and sets scratch.aborted().
+     */
+    void matchAll(std::string_view text, PatternSetScratch& scratch, std::vector<size_t>& ids) const;
+
+    size_t size() const { return patterns.size(); }
+    const CompiledPattern& pattern(size_t i) const { return *patterns[i]; }
+
+    // Unique per instance, like CompiledPattern::id().
+    uint64_t id() const { return uid; }
+
+    // All patterns as one Program, see combinePrograms().
+    const Program& program() const { return combined; }
+
+private:
+    uint64_t uid;
+    std::vector<std::shared_ptr<const CompiledPattern>> patterns;
+    Program combined;
+    LiteralSet literals;        // literal i = requiredLiteral() of pattern i
+    bool filtered = true;       // every pattern has a required literal
+};
+
+/**
+ * PatternSetScratch
+ *  - the combined DFA cache, one MatchScratch per pattern for the
+ *    confirming searches and the per-text flags. One per thread, like
+ *    MatchScratch.
+ */
+class PatternSetScratch {
+public:
+    // Limits applied to each confirming search (see Budget.h).
+    void setLimits(const MatchLimits& l) { limits = l; }
+
+    // True if some search of the last matchAll() ran over its limits.
+    bool aborted() const { return over; }
+
+    // Statistics of all matchAll() calls and their confirming searches since
+    // the last resetStats(), see MatchScratch::stats().
+    MatchStats stats() const;
+    void resetStats();
+
+private:
+    friend class PatternSet;
+    void prepare(const PatternSet& set);
+
+    uint64_t bound = 0;     // PatternSet::id() of the bound set
+    std::optional<LazyDFA> dfa;
+    std::vector<MatchScratch> searches;
+    std::vector<char> found;    // required literal seen, per pattern
+    std::vector<char> matched;  // Program match, per pattern
+    MatchLimits limits;
+    bool over = false;
+    MatchStats counters;        // of matchAll() itself, and of rebound scratches
+    uint64_t dfaBytesBefore = 0;
+};
+
+/**
+ * Parse and compile every pattern into one set. Returns nullptr if one of
+ * them can't be parsed, with its index in *failed if given.
+ */
+std::shared_ptr<const PatternSet> compilePatternSet(const std::vector<std::string>& patterns,
+                                                    size_t* failed = nullptr);
+
+#endif // PATTERN_SET_H
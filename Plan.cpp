@@ -0,0 +1,74 @@
+#include "Plan.h"
+#include "Fold.h"
+
+// True if prog matches exactly one string (one way of folding case throughout), into lit.
+static bool literalProgram(const Program& prog, Literal& lit) {
+    lit = Literal();
+    bool foldKnown = false;
+    int pc = prog.start;
+    for (size_t steps = 0; steps <= prog.code.size(); steps++) {
+        const Instruction& inst = prog.code[pc];
+        switch (inst.op) {
+        case OpCode::Save:
+            pc++;
+            break;
+        case OpCode::Jump:
+            pc = inst.x;
+            break;
+        case OpCode::Char:
+            if (hasOtherCase(inst.ch)) {
+                if (foldKnown && lit.foldCase != inst.foldCase) return false;
+                foldKnown = true;
+                lit.foldCase = inst.foldCase;
+            }
+            lit.text.push_back((char)inst.ch);
+            pc++;
+            break;
+        case OpCode::Match:
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+MatchPlan choosePlan(const Program& prog, const ShiftAnd* bits, const OnePass* onePass, bool deterministic,
+                     int outputGroup, const Literal& prefix, const Literal& suffix, const Literal& required) {
+    MatchPlan plan;
+    // a single string is matched the same way by every engine
+    if (outputGroup == 0 && literalProgram(prog, plan.literal)) {
+        plan.engine = MatchEngine::Literal;
+        return plan;
+    }
+
+    plan.requiredLiteral = !required.text.empty();
+    plan.prefix = !prefix.text.empty();
+    plan.bitScan = bits != nullptr;
+    plan.reverseSuffix = !plan.prefix && !suffix.text.empty();
+    bool wholeOnly = deterministic && outputGroup == 0;
+    if (wholeOnly && bits && bits->acyclic()) {
+        plan.engine = MatchEngine::BitParallel;
+    } else if (wholeOnly) {
+        plan.engine = MatchEngine::DFA;
+    } else if (deterministic && onePass) {
+        plan.engine = MatchEngine::OnePass;
+    } else if (deterministic) {
+        plan.engine = MatchEngine::DFAThenTree;
+    } else {
+        plan.engine = MatchEngine::Backtrack;
+    }
+    return plan;
+}
+
+const char* engineName(MatchEngine engine) {
+    switch (engine) {
+    case MatchEngine::Literal: return "literal";
+    case MatchEngine::BitParallel: return "bit-parallel";
+    case MatchEngine::DFA: return "dfa";
+    case MatchEngine::OnePass: return "one-pass";
+    case MatchEngine::DFAThenTree: return "dfa+tree";
+    case MatchEngine::Backtrack: return "backtrack";
+    }
+    return "?";
+}
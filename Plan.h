@@ -0,0 +1,49 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include "Analysis.h"
+#include "OnePass.h"
+#include "Program.h"
+#include "ShiftAnd.h"
+
+/**
+ * MatchPlan
+ *  - how findMatch() (Search.h) searches for one pattern, chosen once when
+ *    the pattern is compiled by choosePlan() from what the analysis found:
+ *    whether the automaton's answer is exact, which group is asked for,
+ *    how many positions the Program has and its literal content (prefix,
+ *    suffix, required literal).
+ *  - the engine decides a candidate start; the boundaries of the match
+ *    come from the cheapest engine that is exact, and the groups from
+ *    OnePass where it applies, else from the tree matcher, which runs as
+ *    late and on as little as it can.
+ *  - shown by match --explain and --stats.
+ */
+enum class MatchEngine {
+    Literal,        // the pattern is one literal: findLiteral() and nothing else
+    BitParallel,    // exact, loop-free, whole match only: ShiftAnd alone
+    DFA,            // exact, whole match only: the automata alone
+    OnePass,        // exact with \O{N}, one-pass Program: the automata find the
+                    // match, OnePass reads the groups off that span in one scan
+    DFAThenTree,    // exact with \O{N}: the automata find the match, the tree
+                    // matcher fills in the groups on that span only
+    Backtrack       // the automata reject starts, the tree matcher decides
+};
+
+struct MatchPlan {
+    MatchEngine engine = MatchEngine::Backtrack;
+    Literal literal;            // Literal: the whole pattern
+    bool requiredLiteral = false;  // a search without required() is over at once
+    bool prefix = false;        // candidate starts jump between occurrences of prefix()
+    bool bitScan = false;       // ShiftAnd instead of the unanchored DFA for the forward scan
+    bool reverseSuffix = false; // without a prefix: ends of matches are found from occurrences
+                                // of suffix(), scanning back with the reversed Program
+};
+
+MatchPlan choosePlan(const Program& prog, const ShiftAnd* bits, const OnePass* onePass, bool deterministic,
+                     int outputGroup, const Literal& prefix, const Literal& suffix, const Literal& required);
+
+// "literal", "bit-parallel", "dfa", "one-pass", "dfa+tree" or "backtrack".
+const char* engineName(MatchEngine engine);
+
+#endif // PLAN_H
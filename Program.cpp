@@ -0,0 +1,285 @@
+#include "Program.h"
+#include "Fold.h"
+#include "Nodes.h"
+#include <algorithm>
+
+// Small helper that appends instructions and tracks the highest group seen.
+struct Compiler {
+    Program prog;
+    int maxGroup = 0;
+
+    int emit(OpCode op, int x = -1, int y = -1) {
+        prog.code.push_back(Instruction{op, 0, false, x, y});
+        return (int)prog.code.size() - 1;
+    }
+
+    // With foldCase only letters keep the flag, lowered so the DFA compares foldLower(b) with ch.
+    void emitChar(unsigned char ch, bool foldCase) {
+        int i = emit(OpCode::Char);
+        prog.code[i].foldCase = foldCase && hasOtherCase(ch);
+        prog.code[i].ch = foldCase ? foldLower(ch) : ch;
+    }
+
+    int pc() const { return (int)prog.code.size(); }
+
+    void compile(const std::shared_ptr<ASTNode>& node, bool foldCase);
+};
+
+void Compiler::compile(const std::shared_ptr<ASTNode>& node, bool foldCase) {
+    // A missing subexpression (e.g. "()") contributes nothing.
+    if (!node) return;
+
+    switch (node->kind()) {
+    case NodeKind::Character: {
+        auto c = std::static_pointer_cast<CharacterNode>(node);
+        emitChar((unsigned char)c->getChar(), foldCase);
+        break;
+    }
+    case NodeKind::Dot:
+        emit(OpCode::Any);
+        break;
+    case NodeKind::Literal: {
+        auto lit = std::static_pointer_cast<LiteralNode>(node);
+        for (char ch : lit->getText()) {
+            emitChar((unsigned char)ch, foldCase || lit->getFoldCase());
+        }
+        break;
+    }
+    case NodeKind::CharClass: {
+        auto cls = std::static_pointer_cast<CharClassNode>(node);
+        prog.classes.push_back(cls->getSet(foldCase));
+        emit(OpCode::Class, (int)prog.classes.size() - 1);
+        break;
+    }
+    case NodeKind::DotStar: {
+        // L1: any
+        //     split L1, L2
+        // L2:
+        int loop = emit(OpCode::Any);
+        emit(OpCode::Split, loop, pc() + 1);
+        break;
+    }
+    case NodeKind::Sequence: {
+        auto seq = std::static_pointer_cast<SequenceNode>(node);
+        for (auto& c : seq->getChildren()) {
+            compile(c, foldCase);
+        }
+        break;
+    }
+    case NodeKind::Or: {
+        //     split L1, L2
+        // L1: lhs
+        //     jump L3
+        // L2: rhs
+        // L3:
+        auto alt = std::static_pointer_cast<OrNode>(node);
+        int split = emit(OpCode::Split);
+        prog.code[split].x = pc();
+        compile(alt->getLeft(), foldCase);
+        int jump = emit(OpCode::Jump);
+        prog.code[split].y = pc();
+        compile(alt->getRight(), foldCase);
+        prog.code[jump].x = pc();
+        break;
+    }
+    case NodeKind::Group: {
+        auto g = std::static_pointer_cast<GroupNode>(node);
+        int idx = g->getGroupIndex();
+        if (idx >= 0) {
+            maxGroup = std::max(maxGroup, idx);
+            emit(OpCode::Save, 2 * idx);
+        }
+        compile(g->getExpr(), foldCase);
+        if (idx >= 0) {
+            emit(OpCode::Save, 2 * idx + 1);
+        }
+        break;
+    }
+    case NodeKind::Star: {
+        // One or more:
+        // L1: expr
+        //     split L1, L2
+        // L2:
+        auto star = std::static_pointer_cast<StarNode>(node);
+        int loop = pc();
+        compile(star->getExpr(), foldCase);
+        emit(OpCode::Split, loop, pc() + 1);
+        break;
+    }
+    case NodeKind::Count: {
+        auto cnt = std::static_pointer_cast<CountNode>(node);
+        int n = cnt->getCount();
+        if (n == 0) break;
+        int first = pc();
+        compile(cnt->getExpr(), foldCase);
+        long long size = pc() - first;
+        if (n == 1 || n * size <= kMaxRepeatCode) {
+            for (int i = 1; i < n; i++) {
+                compile(cnt->getExpr(), foldCase);
+            }
+            break;
+        }
+        // Too long to spell out: K copies (K < N), the last one repeating
+        //     expr (K - 1 times)
+        // L1: expr
+        //     split L1, L2
+        // L2:
+        long long copies = std::max(1LL, kMaxRepeatCode / size);
+        int loop = first;
+        for (long long i = 1; i < copies; i++) {
+            loop = pc();
+            compile(cnt->getExpr(), foldCase);
+        }
+        emit(OpCode::Split, loop, pc() + 1);
+        prog.exact = false;
+        break;
+    }
+    case NodeKind::IgnoreCase: {
+        auto ic = std::static_pointer_cast<IgnoreCaseNode>(node);
+        compile(ic->getExpr(), true);
+        break;
+    }
+    case NodeKind::OutputGroup:
+        // Only a marker for the caller, nothing to match.
+        break;
+    }
+}
+
+Program compileProgram(const std::shared_ptr<ASTNode>& ast) {
+    Compiler c;
+    c.emit(OpCode::Save, 0);
+    c.compile(ast, false);
+    c.emit(OpCode::Save, 1);
+    c.emit(OpCode::Match);
+    c.prog.start = 0;
+    c.prog.slotCount = 2 * (c.maxGroup + 1);
+    return c.prog;
+}
+
+Program combinePrograms(const std::vector<const Program*>& programs) {
+    Program out;
+    // split P0, L1; L1: split P1, L2; ... the last Split goes to the last two programs
+    size_t splits = programs.size() - 1;
+    out.code.resize(splits, Instruction{OpCode::Split, 0, false, -1, -1});
+
+    for (size_t k = 0; k < programs.size(); k++) {
+        const Program& prog = *programs[k];
+        int base = (int)out.code.size();
+        int classBase = (int)out.classes.size();
+        for (Instruction inst : prog.code) {
+            switch (inst.op) {
+            case OpCode::Split:
+                inst.y += base;
+                inst.x += base;
+                break;
+            case OpCode::Jump:
+                inst.x += base;
+                break;
+            case OpCode::Class:
+                inst.x += classBase;
+                break;
+            case OpCode::Match:
+                inst.x = (int)k;
+                break;
+            default:
+                break;
+            }
+            out.code.push_back(inst);
+        }
+        out.classes.insert(out.classes.end(), prog.classes.begin(), prog.classes.end());
+        out.slotCount = std::max(out.slotCount, prog.slotCount);
+
+        int entry = base + prog.start;
+        if (k < splits) {
+            out.code[k].x = entry;
+            out.code[k].y = k + 1 < splits ? (int)k + 1 : -1;
+        } else if (splits > 0) {
+            out.code[splits - 1].y = entry;
+        }
+    }
+    out.start = splits > 0 ? 0 : programs[0]->start;
+    return out;
+}
+
+Program reverseProgram(const Program& prog) {
+    size_t n = prog.code.size();
+    auto consumes = [&](size_t pc) {
+        OpCode op = prog.code[pc].op;
+        return op == OpCode::Char || op == OpCode::Any || op == OpCode::Class;
+    };
+
+    // where the Program goes on without consuming, turned around: into[v] goes on at v
+    std::vector<std::vector<int>> into(n);
+    int match = -1;
+    for (size_t pc = 0; pc < n; pc++) {
+        const Instruction& inst = prog.code[pc];
+        switch (inst.op) {
+        case OpCode::Split:
+            into[inst.x].push_back((int)pc);
+            into[inst.y].push_back((int)pc);
+            break;
+        case OpCode::Jump:
+            into[inst.x].push_back((int)pc);
+            break;
+        case OpCode::Save:
+            into[pc + 1].push_back((int)pc);
+            break;
+        case OpCode::Match:
+            match = (int)pc;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Instruction v of prog becomes a block: a Split to each way of getting
+    // to v (a Jump to the block of a pc in into[v], the byte consumed by
+    // v - 1 and a Jump to its block, a Match at the start of prog), or an
+    // empty Class if there is none.
+    struct Way {
+        int pc;         // block to go on in, or -1 for Match
+        bool consume;   // consume prog.code[pc] first
+    };
+    std::vector<std::vector<Way>> ways(n);
+    std::vector<int> block(n);
+    int size = 0;
+    for (size_t v = 0; v < n; v++) {
+        for (int u : into[v]) ways[v].push_back(Way{u, false});
+        if (v > 0 && consumes(v - 1)) ways[v].push_back(Way{(int)v - 1, true});
+        if ((int)v == prog.start) ways[v].push_back(Way{-1, false});
+        block[v] = size;
+        size += ways[v].empty() ? 1 : (int)ways[v].size() - 1;
+        for (const Way& w : ways[v]) size += w.consume ? 2 : 1;
+    }
+
+    Program rev;
+    rev.classes = prog.classes;
+    bool none = false;
+    for (size_t v = 0; v < n; v++) {
+        if (ways[v].empty()) {
+            // no way in: a dead end
+            if (!none) rev.classes.push_back(ByteSet());
+            none = true;
+            rev.code.push_back(Instruction{OpCode::Class, 0, false, (int)prog.classes.size(), -1});
+            continue;
+        }
+        int k = (int)ways[v].size();
+        int at = block[v] + k - 1;   // first Way after the Splits
+        for (int i = 0; i + 1 < k; i++) {
+            int next = i + 2 < k ? (int)rev.code.size() + 1 : -1;
+            rev.code.push_back(Instruction{OpCode::Split, 0, false, at, next});
+            at += ways[v][i].consume ? 2 : 1;
+        }
+        if (k > 1) rev.code.back().y = at;
+        for (const Way& w : ways[v]) {
+            if (w.pc < 0) {
+                rev.code.push_back(Instruction{OpCode::Match, 0, false, -1, -1});
+                continue;
+            }
+            if (w.consume) rev.code.push_back(prog.code[w.pc]);
+            rev.code.push_back(Instruction{OpCode::Jump, 0, false, block[w.pc], -1});
+        }
+    }
+    rev.start = block[match];
+    return rev;
+}
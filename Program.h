@@ -0,0 +1,76 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <memory>
+#include <vector>
+#include "AST.h"
+
+/**
+ * A Program is the AST lowered to a flat list of Thompson-NFA instructions.
+ * It is what the automaton engines (see DFA.h) execute instead of walking
+ * the tree through virtual match() calls.
+ *
+ * Note on semantics: the tree matcher in Nodes.h never gives back what a
+ * '*' or a '+' branch has already consumed. The Program describes the plain
+ * regular language of the pattern, which is a superset of what the tree
+ * matcher accepts. So "no match in the Program" is always exact, while a
+ * Program match still has to be confirmed by the tree matcher.
+ *
+ * Large counts: e{N} is spelled out as N copies of e only while that takes
+ * at most kMaxRepeatCode instructions. Beyond that the Program has K copies
+ * and a loop over the last one, e{K-1} e+ with K < N: a superset again, so
+ * the Program (and every automaton built from it) stays O(pattern) in size
+ * for any N, and the tree matcher, whose Count is a counted loop, checks the
+ * exact count. Program::exact tells whether this happened.
+ */
+
+static const int kMaxRepeatCode = 1024;
+
+enum class OpCode {
+    Char,   // consume one byte equal to ch (case-folded if foldCase)
+    Any,    // consume any one byte
+    Class,  // consume one byte in Program::classes[x]
+    Split,  // continue at x and at y (x preferred)
+    Jump,   // continue at x
+    Save,   // record the current position in capture slot x
+    Match   // the pattern matched (x: its index in a combined Program, else -1)
+};
+
+struct Instruction {
+    OpCode op;
+    unsigned char ch;   // Char
+    bool foldCase;      // Char
+    int x;              // Split / Jump target, Save slot, Class set
+    int y;              // Split second target
+};
+
+struct Program {
+    std::vector<Instruction> code;
+    int start = 0;      // index of the first instruction
+    int slotCount = 0;  // 2 per capture group, group 0 included
+    std::vector<ByteSet> classes;  // sets of the Class instructions
+    bool exact = true;  // false if some {N} was compiled as a superset (see above)
+};
+
+/**
+ * Lower an AST produced by parsePattern() into a Program.
+ * Group N saves into slots 2N / 2N+1; group 0 wraps the whole pattern.
+ */
+Program compileProgram(const std::shared_ptr<ASTNode>& ast);
+
+/**
+ * A Program for the reverse of the language of 'prog' (no Save
+ * instructions): it matches text[s, e) read backwards, from e - 1 down to s,
+ * exactly when prog matches text[s, e). See LazyDFA::longestMatchBackward().
+ * 'prog' must have a single Match instruction.
+ */
+Program reverseProgram(const Program& prog);
+
+/**
+ * One Program running all of 'programs' side by side (a Split to each of
+ * them), whose Match instructions carry the index of their program in x.
+ * See LazyDFA::matchingPrograms(). 'programs' must not be empty.
+ */
+Program combinePrograms(const std::vector<const Program*>& programs);
+
+#endif // PROGRAM_H
@@ -0,0 +1,190 @@
+#include "Scan.h"
+#include "Fold.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define SCAN_NEON 1
+#endif
+
+static const size_t kNotFound = (size_t)-1;
+
+// A-Z plus 0x20, the rest unchanged; bytes of 0x80 and up are negative and stay out of the range.
+#if defined(SCAN_X86)
+static inline __m128i lowerSSE2(__m128i v) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#elif defined(SCAN_NEON)
+static inline uint8x16_t lowerNEON(uint8x16_t v) {
+    uint8x16_t upper = vcleq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8('Z' - 'A'));
+    return vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20)));
+}
+#endif
+
+// Inlined into the scan kernels: a call from the AVX2 kernel into SSE code
+// would pay for the switch between the two register states on every candidate.
+static inline bool equalLowered(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+#if defined(SCAN_X86)
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = lowerSSE2(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m128i y = lowerSSE2(_mm_loadu_si128((const __m128i*)(b + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) return false;
+    }
+#elif defined(SCAN_NEON)
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t x = lowerNEON(vld1q_u8((const uint8_t*)a + i));
+        uint8x16_t y = lowerNEON(vld1q_u8((const uint8_t*)b + i));
+        uint8x8_t eq = vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(x, y)), 4);
+        if (vget_lane_u64(vreinterpret_u64_u8(eq), 0) != ~0ull) return false;
+    }
+#endif
+    for (; i < n; i++) {
+        if (foldLower((unsigned char)a[i]) != foldLower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+bool equalFolded(const char* a, const char* b, size_t n) {
+    return equalLowered(a, b, n);
+}
+
+// Checks a candidate whose first and last bytes already passed the filter.
+static bool verify(const char* p, const char* needle, size_t m, bool foldCase) {
+    if (!foldCase) {
+        return m <= 2 || std::memcmp(p + 1, needle + 1, m - 2) == 0;
+    }
+    return equalLowered(p, needle, m);
+}
+
+static size_t scanScalar(const char* hay, size_t n, size_t from,
+                         const char* needle, size_t m, bool foldCase) {
+    if (!foldCase) {
+        // memchr is vectorized by the C library for the exact case
+        while (from + m <= n) {
+            const void* hit = std::memchr(hay + from, needle[0], n - m + 1 - from);
+            if (!hit) return kNotFound;
+            size_t i = (const char*)hit - hay;
+            if (hay[i + m - 1] == needle[m - 1] && verify(hay + i, needle, m, false)) return i;
+            from = i + 1;
+        }
+        return kNotFound;
+    }
+    for (size_t i = from; i + m <= n; i++) {
+        if (verify(hay + i, needle, m, true)) return i;
+    }
+    return kNotFound;
+}
+
+#if defined(SCAN_X86)
+
+#if defined(__GNUC__)
+__attribute__((target("avx2")))
+#endif
+static size_t scanAVX2(const char* hay, size_t n, const char* needle, size_t m,
+                       bool foldCase, size_t& resume) {
+    const char bit = foldCase ? 0x20 : 0;
+    const __m256i fold = _mm256_set1_epi8(bit);
+    const __m256i first = _mm256_set1_epi8((char)(needle[0] | bit));
+    const __m256i last = _mm256_set1_epi8((char)(needle[m - 1] | bit));
+
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(hay + i)), fold);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(hay + i + m - 1)), fold);
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (bits) {
+            size_t k = (size_t)__builtin_ctz(bits);
+            if (verify(hay + i + k, needle, m, foldCase)) return i + k;
+            bits &= bits - 1;
+        }
+    }
+    resume = i;
+    return kNotFound;
+}
+
+static size_t scanSSE2(const char* hay, size_t n, const char* needle, size_t m,
+                       bool foldCase, size_t& resume) {
+    const char bit = foldCase ? 0x20 : 0;
+    const __m128i fold = _mm_set1_epi8(bit);
+    const __m128i first = _mm_set1_epi8((char)(needle[0] | bit));
+    const __m128i last = _mm_set1_epi8((char)(needle[m - 1] | bit));
+
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i*)(hay + i)), fold);
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i*)(hay + i + m - 1)), fold);
+        unsigned bits = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (bits) {
+            size_t k = (size_t)__builtin_ctz(bits);
+            if (verify(hay + i + k, needle, m, foldCase)) return i + k;
+            bits &= bits - 1;
+        }
+    }
+    resume = i;
+    return kNotFound;
+}
+
+static bool haveAVX2() {
+#if defined(__GNUC__)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#elif defined(__AVX2__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+#elif defined(SCAN_NEON)
+
+static size_t scanNEON(const char* hay, size_t n, const char* needle, size_t m,
+                       bool foldCase, size_t& resume) {
+    const uint8_t bit = foldCase ? 0x20 : 0;
+    const uint8x16_t fold = vdupq_n_u8(bit);
+    const uint8x16_t first = vdupq_n_u8((uint8_t)(needle[0] | bit));
+    const uint8x16_t last = vdupq_n_u8((uint8_t)(needle[m - 1] | bit));
+
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        uint8x16_t a = vorrq_u8(vld1q_u8((const uint8_t*)hay + i), fold);
+        uint8x16_t b = vorrq_u8(vld1q_u8((const uint8_t*)hay + i + m - 1), fold);
+        uint8x16_t eq = vandq_u8(vceqq_u8(a, first), vceqq_u8(b, last));
+        // narrow to 4 bits per byte, there is no movemask on NEON
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (bits) {
+            size_t k = (size_t)__builtin_ctzll(bits) / 4;
+            if (verify(hay + i + k, needle, m, foldCase)) return i + k;
+            bits &= ~(0xFull << (k * 4));
+        }
+    }
+    resume = i;
+    return kNotFound;
+}
+
+#endif
+
+size_t findLiteral(const char* hay, size_t n, const char* needle, size_t m, bool foldCase) {
+    if (m == 0) return 0;
+    if (m > n) return kNotFound;
+
+    size_t resume = 0;
+    size_t hit = kNotFound;
+#if defined(SCAN_X86)
+    hit = haveAVX2() ? scanAVX2(hay, n, needle, m, foldCase, resume)
+                     : scanSSE2(hay, n, needle, m, foldCase, resume);
+#elif defined(SCAN_NEON)
+    hit = scanNEON(hay, n, needle, m, foldCase, resume);
+#endif
+    if (hit != kNotFound) return hit;
+    // whatever the vector loop couldn't cover
+    return scanScalar(hay, n, resume, needle, m, foldCase);
+}
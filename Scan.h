@@ -0,0 +1,20 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+
+/**
+ * Vectorized substring search used as a prefilter before running an engine.
+ *
+ * findLiteral() returns the offset of the first occurrence of needle[0..m)
+ * in hay[0..n), or (size_t)-1 if there is none. With foldCase, ASCII letters
+ * compare equal regardless of case (the same rule the matchers use).
+ *
+ * The kernel compares the first and the last needle byte against a whole
+ * vector of haystack positions at once and only verifies the positions
+ * where both agree. It uses AVX2 when the CPU supports it, SSE2 on other
+ * x86-64 machines, NEON on ARM and a scalar loop elsewhere.
+ */
+size_t findLiteral(const char* hay, size_t n, const char* needle, size_t m, bool foldCase);
+
+#endif // SCAN_H
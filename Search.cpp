@@ -0,0 +1,402 @@
+#include "Search.h"
+#include "Scan.h"
+#include "ShiftAnd.h"
+#include <algorithm>
+
+void MatchScratch::prepare(const CompiledPattern& pattern) {
+    budget.start();
+    if (bound != pattern.id()) bind(pattern);
+    // the scratch may have been moved since
+    search->setBudget(&budget);
+    anchored->setBudget(&budget);
+    if (backward) backward->setBudget(&budget);
+}
+
+void MatchScratch::bind(const CompiledPattern& pattern) {
+    // the DFAs are about to be replaced, keep what they counted
+    counters.dfaBytes += dfaBytes() - dfaBytesBefore;
+    dfaBytesBefore = 0;
+    bound = pattern.id();
+    slots.assign(pattern.groupCount(), std::nullopt);
+    search.emplace(pattern.program(), false);
+    anchored.emplace(pattern.program(), true);
+    if (pattern.reversed()) {
+        backward.emplace(*pattern.reversed(), true);
+    } else {
+        backward.reset();
+    }
+}
+
+uint64_t MatchScratch::dfaBytes() const {
+    return (search ? search->bytesScanned() : 0) + (anchored ? anchored->bytesScanned() : 0) +
+           (backward ? backward->bytesScanned() : 0);
+}
+
+MatchStats MatchScratch::stats() const {
+    MatchStats r = counters;
+    r.dfaBytes += dfaBytes() - dfaBytesBefore;
+    return r;
+}
+
+void MatchScratch::resetStats() {
+    counters = MatchStats();
+    dfaBytesBefore = dfaBytes();
+}
+
+/**
+ * Runs the tree matcher with the scratch slots lent to the MatchContext
+ * (moving a vector doesn't allocate, and every group already has its slot,
+ * so GroupNode never needs to grow it). Returns whether it matched and,
+ * through hitEnd, whether the answer depended on the end of 'text'.
+ * memo may be null; memoized results don't record hitEnd, so streaming
+ * searches run without one. If the budget runs out, false is returned and
+ * budget.exceeded() is set. stats only counts with SIMPLEPARSER_STATS.
+ */
+static bool runFlat(const CompiledPattern& pattern, std::string_view text, size_t start,
+                    std::vector<std::optional<CaptureGroup>>& slots, bool& hitEnd,
+                    MatchMemo* memo, MatchBudget& budget, MatchStats& stats)
+{
+    std::fill(slots.begin(), slots.end(), std::nullopt);
+    MatchContext ctx { text, start, std::move(slots), false };
+    if (memo && memo->begin(text, start, pattern.arena().memoSlots)) {
+        ctx.memo = memo;
+    }
+    ctx.budget = &budget;
+    ctx.stats = &stats;
+    MATCH_STATS(stats.treeRuns++);
+
+    bool ok = matchFlat(pattern.arena(), ctx) && !budget.exceeded();
+    // store entire match as capture group 0
+    if (ok && !ctx.captures[0].has_value()) {
+        ctx.captures[0] = CaptureGroup{start, ctx.position, true};
+    }
+    slots = std::move(ctx.captures);
+    hitEnd = ctx.hitEnd;
+    return ok;
+}
+
+/**
+ * On success the captures are stored (group 0 = entire match) and true is returned.
+ */
+bool matchAt(const CompiledPattern& pattern, std::string_view text, size_t start,
+             MatchScratch& scratch)
+{
+    scratch.prepare(pattern);
+    scratch.memo.reset();
+    bool hitEnd = false;
+    return runFlat(pattern, text, start, scratch.slots, hitEnd, &scratch.memo, scratch.budget, scratch.counters);
+}
+
+/**
+ * The compiled Program accepts everything the AST can match (and possibly more).
+ * The search is a single forward pass of the unanchored DFA: it stops at the
+ * earliest position 'end' where any Program match finishes, so the leftmost match
+ * (if any) must start in [from, end]. Only those starts are tried, each first with
+ * an anchored DFA run and then with the (flattened, see Arena.h) tree matcher, before the unanchored scan
+ * resumes after 'end'. If isDeterministic() holds, the DFA answer is already exact
+ * and the tree matcher is only run on the matched window when a group is needed,
+ * or not even then if the Program is one-pass (OnePass.h reads the groups off it).
+ *
+ * Programs with at most 64 positions scan with their ShiftAnd form instead of the
+ * unanchored DFA (no states to build, a few word operations per byte). If such a
+ * pattern is also deterministic, has no loops and only the whole match is asked for,
+ * ShiftAnd settles each candidate too and neither DFA nor the tree matcher runs.
+ *
+ * Before any of that, the literals every match must contain are looked up with the
+ * vectorized scanner in Scan.h: a missing required literal means no match at all, and
+ * a required prefix lets both the DFA scan and the candidate loop jump from one
+ * occurrence of the prefix to the next. Without a prefix, a required suffix replaces
+ * the forward scan: 'end' is found at an occurrence of the suffix that the reversed
+ * Program, run backwards from it, accepts.
+ *
+ * The anchored DFA runs and the tree matcher (through its memo table, Memo.h) both
+ * share work across all the starts tried, so overlapping attempts on a long run of
+ * candidates don't rescan the same text over and over.
+ *
+ * With a 'last' start, every scan stops once the starts up to it are settled, so the
+ * cost depends on the size of [first, last] rather than on what follows (the required
+ * literal is then left to the caller, as it may lie anywhere after 'last').
+ */
+size_t findMatch(const CompiledPattern& pattern, std::string_view text, MatchScratch& scratch,
+                 size_t first, size_t last)
+{
+    scratch.prepare(pattern);
+    MATCH_STATS(MatchStats& stats = scratch.counters; stats.searches++; StatsTimer timer(stats.time));
+    if (first > text.size() || first > last) {
+        return std::string_view::npos;
+    }
+    last = std::min(last, text.size());
+    const MatchPlan& plan = pattern.plan();
+    if (plan.engine == MatchEngine::Literal) {
+        const Literal& lit = plan.literal;
+        MATCH_STATS(stats.prefixScans++);
+        size_t window = std::min(text.size(), last + lit.text.size()) - first;
+        size_t hit = findLiteral(text.data() + first, window, lit.text.data(), lit.text.size(), lit.foldCase);
+        if (hit == std::string_view::npos) return hit;
+        std::fill(scratch.slots.begin(), scratch.slots.end(), std::nullopt);
+        scratch.slots[0] = CaptureGroup{first + hit, first + hit + lit.text.size(), true};
+        MATCH_STATS(stats.matches++);
+        return first + hit;
+    }
+
+    const Literal& required = pattern.required();
+    if (plan.requiredLiteral && last == text.size() &&
+        findLiteral(text.data() + first, text.size() - first, required.text.data(),
+                    required.text.size(), required.foldCase) == std::string_view::npos) {
+        MATCH_STATS(stats.literalRejects++);
+        return std::string_view::npos;
+    }
+
+    // next position >= pos where the prefix occurs (pos itself without a prefix)
+    const Literal& prefix = pattern.prefix();
+    auto nextCandidate = [&](size_t pos) -> size_t {
+        if (!plan.prefix || pos > last) return pos;
+        MATCH_STATS(stats.prefixScans++);
+        size_t window = std::min(text.size(), last + prefix.text.size()) - pos;
+        size_t hit = findLiteral(text.data() + pos, window, prefix.text.data(),
+                                 prefix.text.size(), prefix.foldCase);
+        return hit == std::string_view::npos ? hit : pos + hit;
+    };
+
+    scratch.memo.reset();
+    LazyDFA& search = *scratch.search;
+    LazyDFA& anchored = *scratch.anchored;
+    anchored.newSeries();
+    bool hitEnd = false;
+    const ShiftAnd* bits = plan.bitScan ? pattern.shiftAnd() : nullptr;
+    // the end of the match at a start the automata accepted (exact patterns only)
+    auto matchEnd = [&](size_t start) {
+        return bits ? bits->longestMatch(text, start, &scratch.budget) : anchored.longestMatch(text, start);
+    };
+    auto found = [&](size_t start, size_t end) {
+        // the scan for the end may have run out of budget
+        if (scratch.budget.exceeded()) return std::string_view::npos;
+        std::fill(scratch.slots.begin(), scratch.slots.end(), std::nullopt);
+        scratch.slots[0] = CaptureGroup{start, end, true};
+        MATCH_STATS(stats.matches++);
+        return start;
+    };
+
+    // Without a prefix, the end of the earliest match is looked for at the occurrences
+    // of the suffix instead, each checked by a backward run of the reversed Program.
+    // A run that would go back past the previous occurrence gives up (the forward
+    // scan takes over), so no byte is scanned backwards twice.
+    const Literal& suffix = pattern.suffix();
+    bool backwards = plan.reverseSuffix && last == text.size();
+    auto reverseEnd = [&](size_t from) -> size_t {
+        size_t floor = from;
+        for (size_t at = from; ; ) {
+            MATCH_STATS(stats.suffixScans++);
+            size_t hit = findLiteral(text.data() + at, text.size() - at, suffix.text.data(),
+                                     suffix.text.size(), suffix.foldCase);
+            if (hit == std::string_view::npos) return hit;
+            size_t end = at + hit + suffix.text.size();
+            bool reachedFloor = false;
+            if (scratch.backward->longestMatchBackward(text, end, floor, &reachedFloor) != std::string_view::npos) {
+                return end;
+            }
+            if (scratch.budget.exceeded()) return std::string_view::npos;
+            if (reachedFloor && floor > from) {
+                backwards = false;
+                return std::string_view::npos;
+            }
+            floor = end;
+            at += hit + 1;
+        }
+    };
+    auto earliestEnd = [&](size_t from) {
+        if (backwards) {
+            size_t end = reverseEnd(from);
+            if (backwards) return end;
+        }
+        size_t end = bits ? bits->earliestEnd(text, from, last, &scratch.budget)
+                          : search.earliestEnd(text, from, nullptr, last);
+        MATCH_STATS(if (bits) stats.dfaBytes += std::min(end, text.size()) - from);
+        return end;
+    };
+
+    size_t from = nextCandidate(first);
+    while (from <= last) {
+        size_t end = earliestEnd(from);
+        if (end == std::string_view::npos) {
+            return std::string_view::npos;
+        }
+
+        for (size_t start = from; start <= std::min(end, last); start = nextCandidate(start + 1)) {
+            if (!scratch.budget.charge()) return std::string_view::npos;
+            MATCH_STATS(stats.candidates++);
+            if (plan.engine == MatchEngine::BitParallel) {
+                // no loops: each try reads at most bits->positions() bytes
+                size_t e = bits->longestMatch(text, start, &scratch.budget);
+                if (e != std::string_view::npos) return found(start, e);
+                MATCH_STATS(stats.anchoredRejects++);
+                continue;
+            }
+            if (!anchored.matchesInSeries(text, start)) {
+                MATCH_STATS(stats.anchoredRejects++);
+                continue;
+            }
+
+            switch (plan.engine) {
+            case MatchEngine::DFA:
+                return found(start, matchEnd(start));
+            case MatchEngine::OnePass: {
+                size_t stop = matchEnd(start);
+                if (scratch.budget.exceeded()) return std::string_view::npos;
+                if (pattern.onePass()->capture(text.substr(0, stop), start, scratch.saved)) {
+                    found(start, stop);
+                    for (size_t g = 1; g < scratch.slots.size() && 2 * g + 1 < scratch.saved.size(); g++) {
+                        size_t s = scratch.saved[2 * g], e = scratch.saved[2 * g + 1];
+                        if (s != std::string_view::npos && e != std::string_view::npos) {
+                            scratch.slots[g] = CaptureGroup{s, e, true};
+                        }
+                    }
+                    return start;
+                }
+                // OnePass should take every span the automata match (OnePass.h); if
+                // it ever doesn't, its slots mean nothing and the tree matcher decides
+                [[fallthrough]];
+            }
+            case MatchEngine::DFAThenTree:
+                // the groups can't reach past the match, so the tree matcher needn't look further
+                runFlat(pattern, text.substr(0, matchEnd(start)), start, scratch.slots, hitEnd,
+                        &scratch.memo, scratch.budget, scratch.counters);
+                if (scratch.budget.exceeded()) return std::string_view::npos;
+                MATCH_STATS(stats.matches++);
+                return start;
+            default:
+                if (runFlat(pattern, text, start, scratch.slots, hitEnd, &scratch.memo, scratch.budget, scratch.counters)) {
+                    MATCH_STATS(stats.matches++);
+                    return start;
+                }
+                if (scratch.budget.exceeded()) return std::string_view::npos;
+            }
+        }
+        from = nextCandidate(end + 1);
+    }
+    return std::string_view::npos;
+}
+
+/**
+ * Same passes as findMatch() over what has been read so far: a forward scan with
+ * the unanchored DFA (or ShiftAnd) finds the earliest end of a Program match, and
+ * only the starts up to it are tried, with anchored DFA runs in one series and
+ * then the tree matcher. What can't be settled yet is kept for the next chunk:
+ * from a start whose anchored run or tree match needs more input, or, if no end
+ * was found, from the earliest start whose anchored run is still alive at the end
+ * of the buffer (everything before it can't begin a match any more).
+ *
+ * Whatever is kept is scanned again once more input is there, so the reader is
+ * asked for at least as much new input as was kept: the kept text at least
+ * doubles between scans and every byte is scanned a bounded number of times.
+ */
+bool findMatchInStream(const CompiledPattern& pattern, ChunkReader& reader, MatchScratch& scratch,
+                       size_t from)
+{
+    const Literal& prefix = pattern.prefix();
+    scratch.prepare(pattern);
+    LazyDFA& search = *scratch.search;
+    LazyDFA& anchored = *scratch.anchored;
+    const ShiftAnd* bits = pattern.plan().bitScan ? pattern.shiftAnd() : nullptr;
+    MATCH_STATS(MatchStats& stats = scratch.counters; stats.searches++; StatsTimer timer(stats.time));
+
+    // a resumed search drops what the previous one consumed; the view may
+    // still hold bytes nobody looked at, so nothing is read yet ('from' may
+    // be one past the end, after an empty match there)
+    size_t drop = std::min(from, reader.view().size());
+    reader.consume(drop);
+    size_t start = from - drop;
+    while (true) {
+        std::string_view text = reader.view();
+        bool more = !reader.eof();
+        size_t keepFrom = text.size();
+        anchored.newSeries();
+
+        // next position >= pos where the prefix occurs (pos itself without a prefix);
+        // without one, the last bytes, which may still begin an occurrence
+        auto nextCandidate = [&](size_t pos) -> size_t {
+            if (prefix.text.empty() || pos > text.size()) return pos;
+            MATCH_STATS(stats.prefixScans++);
+            size_t hit = findLiteral(text.data() + pos, text.size() - pos, prefix.text.data(),
+                                     prefix.text.size(), prefix.foldCase);
+            if (hit != std::string_view::npos) return pos + hit;
+            size_t tail = prefix.text.size() - 1;
+            return text.size() > pos + tail ? text.size() - tail : pos;
+        };
+
+        bool undecided = false;
+        start = nextCandidate(start);
+        while (start <= text.size() && !undecided) {
+            size_t end = bits ? bits->earliestEnd(text, start, std::string::npos, &scratch.budget)
+                              : search.earliestEnd(text, start);
+            MATCH_STATS(if (bits) stats.dfaBytes += std::min(end, text.size()) - start);
+            if (scratch.budget.exceeded()) return false;
+            if (end == std::string_view::npos) {
+                if (!more) return false;
+                // no match ends in text: keep from the first start that may still begin one
+                for (; start <= text.size(); start++) {
+                    if (!scratch.budget.charge()) return false;
+                    if (anchored.runInSeries(text, start) != LazyDFA::Run::Dead) break;
+                }
+                keepFrom = start;
+                break;
+            }
+
+            for (; start <= end; start = nextCandidate(start + 1)) {
+                if (!scratch.budget.charge()) return false;
+                MATCH_STATS(stats.candidates++);
+                LazyDFA::Run run = anchored.runInSeries(text, start);
+                if (run == LazyDFA::Run::NeedsMore && more) {
+                    keepFrom = start;
+                    undecided = true;
+                    break;
+                }
+                if (run != LazyDFA::Run::Match) {
+                    MATCH_STATS(stats.anchoredRejects++);
+                    continue;
+                }
+
+                bool hitEnd = false;
+                bool ok = runFlat(pattern, text, start, scratch.slots, hitEnd, nullptr, scratch.budget,
+                                  scratch.counters);
+                if (scratch.budget.exceeded()) return false;
+                if (hitEnd && more) {
+                    keepFrom = start;
+                    undecided = true;
+                    break;
+                }
+                if (ok) {
+                    MATCH_STATS(stats.matches++);
+                    return true;
+                }
+            }
+        }
+
+        if (!more) return false;
+        keepFrom = std::min(keepFrom, text.size());
+        size_t kept = text.size() - keepFrom;
+        reader.refill(keepFrom);
+        while (!reader.eof() && reader.view().size() < 2 * kept) reader.refill(0);
+        start = keepFrom < start ? start - keepFrom : 0;
+    }
+}
+
+MatchIterator::MatchIterator(const CompiledPattern& p, std::string_view t, MatchScratch& s, size_t f)
+    : pattern(p), text(t), scratch(s), from(f) {}
+
+bool MatchIterator::next() {
+    if (from > text.size()) return false;
+    if (findMatch(pattern, text, scratch, from) == std::string_view::npos) {
+        from = std::string_view::npos;
+        return false;
+    }
+    const CaptureGroup& whole = match();
+    from = whole.endIndex > whole.startIndex ? whole.endIndex : whole.startIndex + 1;
+    return true;
+}
+
+std::string_view MatchIterator::group(int g) const {
+    const auto& caps = scratch.captures();
+    if (g < 0 || g >= (int)caps.size() || !caps[g].has_value()) return std::string_view();
+    return text.substr(caps[g]->startIndex, caps[g]->endIndex - caps[g]->startIndex);
+}
@@ -0,0 +1,143 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "AST.h"
+#include "Budget.h"
+#include "DFA.h"
+#include "Input.h"
+#include "Memo.h"
+#include "Pattern.h"
+#include "Stats.h"
+
+/**
+ * Search drivers: find the leftmost match of a compiled pattern in some input
+ * and fill in the capture groups (group 0 = entire match).
+ */
+
+/**
+ * MatchScratch
+ *  - all the mutable state a search needs: capture slots, the DFA caches,
+ *    the memo table of the tree matcher and the step / time budget.
+ *  - sized from the pattern the first time it is used with it and then
+ *    reused, so repeated searches with the same pattern and scratch don't
+ *    allocate once the DFA states they visit have been built.
+ *  - one scratch per thread; the CompiledPattern itself can be shared.
+ *  - also collects the statistics of its searches, see stats().
+ */
+class MatchScratch {
+public:
+    // Captures of the last successful match, one slot per group.
+    const std::vector<std::optional<CaptureGroup>>& captures() const { return slots; }
+
+    // Binds the scratch to 'pattern' (if it isn't already) and starts a new
+    // search, resetting the budget.
+    void prepare(const CompiledPattern& pattern);
+
+    // DFA caches of the bound pattern.
+    LazyDFA& unanchoredDFA() { return *search; }
+    LazyDFA& anchoredDFA() { return *anchored; }
+
+    // Memory for the tree matcher's memo table (see Memo.h); 0 turns it off.
+    void setMemoBudget(size_t bytes) { memo.setBudget(bytes); }
+
+    // Limits applied to each search made with this scratch (see Budget.h).
+    void setLimits(const MatchLimits& limits) { budget.setLimits(limits); }
+    const MatchLimits& limits() const { return budget.getLimits(); }
+
+    // True if the last search gave up because it ran over its limits; its
+    // "no match" answer then means nothing.
+    bool aborted() const { return budget.exceeded(); }
+
+    // Counters of all searches since the last resetStats() (see Stats.h;
+    // all zero unless built with SIMPLEPARSER_STATS).
+    MatchStats stats() const;
+    void resetStats();
+
+private:
+    friend class CompiledPattern;   // matches() counts its DFA-only searches
+    friend bool matchAt(const CompiledPattern&, std::string_view, size_t, MatchScratch&);
+    friend size_t findMatch(const CompiledPattern&, std::string_view, MatchScratch&, size_t, size_t);
+    friend bool findMatchInStream(const CompiledPattern&, ChunkReader&, MatchScratch&, size_t);
+    friend size_t findMatchParallel(const CompiledPattern&, std::string_view, MatchScratch&, unsigned);
+
+    uint64_t bound = 0;     // CompiledPattern::id() of the bound pattern
+    std::vector<std::optional<CaptureGroup>> slots;
+    std::optional<LazyDFA> search;    // unanchored
+    std::optional<LazyDFA> anchored;
+    std::optional<LazyDFA> backward;  // anchored, on pattern.reversed() if there is one
+    std::vector<size_t> saved;      // Save slots of OnePass::capture()
+    std::vector<size_t> batchRecords;  // records of matchesBatch() that have the required literal
+    MatchMemo memo;
+    MatchBudget budget;
+    MatchStats counters;
+    uint64_t dfaBytesBefore = 0;  // already in counters, or from before resetStats()
+
+    uint64_t dfaBytes() const;
+    // Sizes the slots and builds the DFAs for 'pattern'.
+    void bind(const CompiledPattern& pattern);
+};
+
+// Run the (flattened) tree matcher anchored at 'start'.
+bool matchAt(const CompiledPattern& pattern, std::string_view text, size_t start,
+             MatchScratch& scratch);
+
+/**
+ * Tries to find a match of the given pattern in the input, starting at or after 'from'
+ * (and at or before 'last'; the match itself may still extend past it).
+ * If found, returns the position and sets up scratch.captures().
+ * If not found, or if the search ran over scratch.limits() (scratch.aborted()),
+ * returns npos.
+ * Groups other than 0 and pattern.outputGroup() may be left unset.
+ */
+size_t findMatch(const CompiledPattern& pattern, std::string_view text, MatchScratch& scratch,
+                 size_t from = 0, size_t last = std::string_view::npos);
+
+/**
+ * Same search for input that arrives in chunks (pipes). Bytes before the
+ * earliest start that is still undecided are dropped from the reader, so
+ * only the undecided tail is carried over to the next chunk, and the search
+ * returns as soon as a match is certain instead of waiting for EOF.
+ * On success the captures are relative to reader.view().
+ * 'from' resumes a search at that offset of the current reader.view()
+ * (e.g. the end of the previous match); everything before it is dropped.
+ */
+bool findMatchInStream(const CompiledPattern& pattern, ChunkReader& reader, MatchScratch& scratch,
+                       size_t from = 0);
+
+/**
+ * MatchIterator
+ *  - walks the non-overlapping matches of a pattern from left to right:
+ *    each search resumes where the previous match ended, and an empty match
+ *    moves on by one so the iteration always progresses.
+ *  - all searches share one scratch (DFA states and capture slots), so
+ *    iterating allocates nothing once the DFA is warm.
+ *
+ *   MatchIterator it(*pattern, text, scratch);
+ *   while (it.next()) { ... it.group(pattern->outputGroup()) ... }
+ */
+class MatchIterator {
+public:
+    MatchIterator(const CompiledPattern& pattern, std::string_view text, MatchScratch& scratch,
+                  size_t from = 0);
+
+    // Moves to the next match; false once there are no more.
+    bool next();
+
+    // Group 0 of the current match.
+    const CaptureGroup& match() const { return *scratch.captures()[0]; }
+
+    // Text of group g of the current match (empty if it didn't take part).
+    std::string_view group(int g) const;
+
+private:
+    const CompiledPattern& pattern;
+    std::string_view text;
+    MatchScratch& scratch;
+    size_t from;
+};
+
+#endif // SEARCH_H
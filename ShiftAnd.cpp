@@ -0,0 +1,150 @@
+#include "ShiftAnd.h"
+#include "Fold.h"
+#include <algorithm>
+
+// Positions reachable from pc through Split / Jump / Save, and whether Match is.
+struct Closure {
+    uint64_t positions = 0;
+    bool match = false;
+};
+
+static Closure closure(const Program& prog, const std::vector<int>& position, int pc) {
+    Closure c;
+    std::vector<char> seen(prog.code.size(), 0);
+    std::vector<int> stack{pc};
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        if (seen[i]) continue;
+        seen[i] = 1;
+
+        const Instruction& inst = prog.code[i];
+        switch (inst.op) {
+        case OpCode::Split:
+            stack.push_back(inst.y);
+            stack.push_back(inst.x);
+            break;
+        case OpCode::Jump:
+            stack.push_back(inst.x);
+            break;
+        case OpCode::Save:
+            stack.push_back(i + 1);
+            break;
+        case OpCode::Match:
+            c.match = true;
+            break;
+        case OpCode::Char:
+        case OpCode::Any:
+        case OpCode::Class:
+            c.positions |= uint64_t(1) << position[i];
+            break;
+        }
+    }
+    return c;
+}
+
+std::optional<ShiftAnd> ShiftAnd::compile(const Program& prog) {
+    // number the positions in Program order, so runs of characters are runs of bits
+    std::vector<int> position(prog.code.size(), -1);
+    std::vector<int> pcs;
+    for (size_t pc = 0; pc < prog.code.size(); pc++) {
+        OpCode op = prog.code[pc].op;
+        if (op == OpCode::Char || op == OpCode::Any || op == OpCode::Class) {
+            if (pcs.size() == (size_t)kMaxPositions) return std::nullopt;
+            position[pc] = (int)pcs.size();
+            pcs.push_back((int)pc);
+        }
+    }
+
+    ShiftAnd sa;
+    sa.count = (int)pcs.size();
+    Closure start = closure(prog, position, prog.start);
+    sa.first = start.positions;
+    sa.acceptsEmpty = start.match;
+
+    std::vector<uint64_t> other(pcs.size(), 0);
+    for (size_t i = 0; i < pcs.size(); i++) {
+        const Instruction& inst = prog.code[pcs[i]];
+        uint64_t bit = uint64_t(1) << i;
+        if (inst.op == OpCode::Any) {
+            for (uint64_t& m : sa.masks) m |= bit;
+        } else if (inst.op == OpCode::Class) {
+            for (int b = 0; b < 256; b++) {
+                if (prog.classes[inst.x][b]) sa.masks[b] |= bit;
+            }
+        } else {
+            sa.masks[inst.ch] |= bit;
+            if (inst.foldCase) sa.masks[otherCase(inst.ch)] |= bit;
+        }
+
+        Closure next = closure(prog, position, pcs[i] + 1);
+        if (next.match) sa.accept |= bit;
+        uint64_t following = bit << 1;
+        if (i + 1 < pcs.size() && (next.positions & following)) {
+            sa.shifted |= bit;
+            next.positions &= ~following;
+        }
+        // anything at or before i is a way back
+        if (next.positions & (bit | (bit - 1))) sa.noLoops = false;
+        other[i] = next.positions;
+    }
+
+    for (size_t group = 0; group * 8 < pcs.size(); group++) {
+        bool any = false;
+        for (size_t i = group * 8; i < pcs.size() && i < group * 8 + 8; i++) any |= other[i] != 0;
+        if (!any) continue;
+        sa.jumpGroups.push_back((uint8_t)group);
+        for (int v = 0; v < 256; v++) {
+            uint64_t to = 0;
+            for (int k = 0; k < 8; k++) {
+                if ((v >> k) & 1 && group * 8 + k < pcs.size()) to |= other[group * 8 + k];
+            }
+            sa.jumps.push_back(to);
+        }
+    }
+    return sa;
+}
+
+size_t ShiftAnd::earliestEnd(std::string_view text, size_t from, size_t lastStart,
+                             MatchBudget* budget) const {
+    if (acceptsEmpty) return from;
+    uint64_t reach = first;
+    const unsigned char* p = (const unsigned char*)text.data();
+    const unsigned char* end = p + text.size();
+    // a new match may begin at every start up to lastStart, i.e. after every byte before it
+    const unsigned char* seeding = p + std::min(lastStart, text.size());
+    // the budget is charged a block at a time, out of the loop over the bytes
+    size_t block = budget && budget->active() ? MatchBudget::kScanBlock : text.size();
+    for (const unsigned char* at = p + from; at < end; ) {
+        if (at > p + from && !budget->charge(MatchBudget::kScanBlock)) return std::string::npos;
+        for (const unsigned char* stop = at + std::min<size_t>(block, end - at); at < stop; at++) {
+            uint64_t state = reach & masks[*at];
+            if (state & accept) return at - p + 1;
+            reach = follow(state);
+            if (at < seeding) {
+                reach |= first;
+            } else if (reach == 0) {
+                return std::string::npos;
+            }
+        }
+    }
+    return std::string::npos;
+}
+
+size_t ShiftAnd::longestMatch(std::string_view text, size_t from, MatchBudget* budget) const {
+    size_t last = acceptsEmpty ? from : std::string::npos;
+    uint64_t reach = first;
+    const unsigned char* p = (const unsigned char*)text.data();
+    const unsigned char* end = p + text.size();
+    size_t block = budget && budget->active() ? MatchBudget::kScanBlock : text.size();
+    for (const unsigned char* at = p + from; at < end; ) {
+        if (at > p + from && !budget->charge(MatchBudget::kScanBlock)) return std::string::npos;
+        for (const unsigned char* stop = at + std::min<size_t>(block, end - at); at < stop; at++) {
+            uint64_t state = reach & masks[*at];
+            if (state == 0) return last;
+            if (state & accept) last = at - p + 1;
+            reach = follow(state);
+        }
+    }
+    return last;
+}
@@ -0,0 +1,70 @@
+#ifndef SHIFT_AND_H
+#define SHIFT_AND_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Budget.h"
+#include "Program.h"
+
+/**
+ * ShiftAnd
+ *  - bit-parallel simulation of a Program with at most kMaxPositions
+ *    positions (its Char / Any / Class instructions): the Glushkov
+ *    automaton, one bit per position in a 64-bit word.
+ *  - a step is "the positions that may come next, and those accepting the
+ *    byte": next = follow(state) & masks[byte]. follow() shifts the word by
+ *    one for positions that are followed by the next one in the Program
+ *    (runs of characters), and looks up the other successors (loops, the
+ *    ends of Or branches) 8 positions at a time in precomputed tables.
+ *  - built once with the CompiledPattern and never changes, so unlike the
+ *    LazyDFA it needs no scratch, builds no states and can't thrash on
+ *    patterns like "a.{20}b" whose DFA has a state per combination.
+ *  - answers the same questions as LazyDFA (same Program semantics), see
+ *    there for the meaning of each.
+ */
+class ShiftAnd {
+public:
+    static constexpr int kMaxPositions = 64;
+
+    // Nothing if the Program has more than kMaxPositions positions.
+    static std::optional<ShiftAnd> compile(const Program& prog);
+
+    // Unanchored, like LazyDFA::earliestEnd() without hitEnd. Bytes are
+    // charged to budget (if given) as LazyDFA does.
+    size_t earliestEnd(std::string_view text, size_t from = 0,
+                       size_t lastStart = std::string::npos, MatchBudget* budget = nullptr) const;
+
+    // Anchored, like LazyDFA::longestMatch().
+    size_t longestMatch(std::string_view text, size_t from, MatchBudget* budget = nullptr) const;
+
+    // No loops: every match is at most positions() bytes long.
+    bool acyclic() const { return noLoops; }
+    int positions() const { return count; }
+
+private:
+    uint64_t masks[256] = {};   // positions that accept each byte
+    uint64_t first = 0;         // positions a match can begin with
+    uint64_t shifted = 0;       // positions followed by the next position
+    uint64_t accept = 0;        // positions a match can end after
+    bool acceptsEmpty = false;
+    bool noLoops = true;
+    int count = 0;
+
+    // Successors other than the next position: 256 entries per group of
+    // 8 positions that has any, indexed by those 8 bits of the state.
+    std::vector<uint8_t> jumpGroups;
+    std::vector<uint64_t> jumps;
+
+    uint64_t follow(uint64_t state) const {
+        uint64_t next = (state & shifted) << 1;
+        for (size_t k = 0; k < jumpGroups.size(); k++) {
+            next |= jumps[k * 256 + ((state >> (8 * jumpGroups[k])) & 0xff)];
+        }
+        return next;
+    }
+};
+
+#endif // SHIFT_AND_H
@@ -0,0 +1,26 @@
+#ifndef SIMPLE_PARSER_H
+#define SIMPLE_PARSER_H
+
+/**
+ * Public header of the simpleparser library.
+ *
+ *   auto pattern = compilePattern("promise to (Love+Hate)\\I you");
+ *   MatchScratch scratch;                // one per thread
+ *   for (std::string_view line : lines) {
+ *       if (pattern->find(line, scratch)) { ... scratch.captures() ... }
+ *   }
+ */
+
+#include "AST.h"
+#include "Batch.h"
+#include "Input.h"
+#include "Parallel.h"
+#include "Parser.h"
+#include "Pattern.h"
+#include "PatternCache.h"
+#include "PatternFile.h"
+#include "PatternSet.h"
+#include "Search.h"
+#include "StaticPattern.h"
+
+#endif // SIMPLE_PARSER_H
@@ -0,0 +1,393 @@
+#ifndef STATIC_PATTERN_H
+#define STATIC_PATTERN_H
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include "AST.h"
+#include "Fold.h"
+
+/**
+ * Patterns fixed at build time, parsed by the compiler.
+ *
+ *   static constexpr char kDate[] = "(0+1+2+3)*-(0+1)*\\O{1}";
+ *   using Date = StaticPattern<kDate>;
+ *   Date::Captures caps;
+ *   if (Date::find(line, caps)) { ... caps[Date::outputGroup()] ... }
+ *
+ *  - header-only: the pattern is parsed by a constexpr copy of Parser.cpp
+ *    (same grammar, same quirks) into a StaticTree, and each node of the
+ *    tree becomes a template instantiation of StaticPattern::matchNode(),
+ *    so matching has no virtual calls, no heap and can be inlined whole.
+ *  - matches exactly like the tree matcher of compilePattern() (leftmost
+ *    start, possessive repetition, first Or branch that succeeds, captures
+ *    of failed attempts left in place), but without its memo table, DFA or
+ *    prefilters: meant for small patterns on short inputs.
+ *  - the source must be a char array with static storage duration (a
+ *    string literal can't be a template argument in C++17). A pattern that
+ *    parsePattern() rejects doesn't compile.
+ *  - \I folds ASCII letters only, with the tables of Fold.h like the
+ *    runtime matchers.
+ */
+
+// One node of a StaticTree; a and b as in FlatNode (Arena.h).
+struct StaticNode {
+    NodeKind kind = NodeKind::Dot;
+    char ch = 0;    // Character
+    int a = -1;     // child (Group: -1 = empty); Sequence: first child; Or: left
+    int b = 0;      // Or: right; Group: index; Count: n; Sequence: child count
+    int next = -1;  // next sibling in a Sequence
+};
+
+template <size_t Capacity>
+struct StaticTree {
+    StaticNode nodes[Capacity] = {};
+    int size = 0;
+    int root = -1;      // -1: the pattern doesn't parse
+    int groups = 1;     // counting group 0
+    int output = 0;     // \O{N}
+};
+
+constexpr size_t staticLength(const char* s) {
+    size_t n = 0;
+    while (s[n] != '\0') n++;
+    return n;
+}
+
+// Parser.cpp, function by function, with node indices for shared_ptrs.
+template <size_t Capacity>
+class StaticParser {
+public:
+    constexpr explicit StaticParser(const char* s) : text(s), length(staticLength(s)) {}
+
+    constexpr StaticTree<Capacity> parse() {
+        tree.root = parseExpr();
+        if (!end() && current() == '\\') {
+            size_t savedPos = pos;
+            advance();
+            if (!end() && (current() == 'O' || current() == 'o')) {
+                advance();
+                if (!end() && current() == '{') {
+                    tree.output = parseBraces();
+                } else {
+                    pos = savedPos;
+                }
+            } else {
+                pos = savedPos;
+            }
+        }
+        // anything after EXPR and \O{N} fails the parse
+        if (!end()) tree.root = -1;
+        tree.groups = groupCounter;
+        return tree;
+    }
+
+private:
+    const char* text;
+    size_t length;
+    size_t pos = 0;
+    int groupCounter = 1;
+    StaticTree<Capacity> tree;
+
+    constexpr bool end() const { return pos >= length; }
+    constexpr char current() const { return end() ? '\0' : text[pos]; }
+    constexpr void advance() { if (!end()) pos++; }
+    constexpr bool matchChar(char c) {
+        if (!end() && current() == c) {
+            advance();
+            return true;
+        }
+        return false;
+    }
+    static constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    static constexpr bool isSpecial(char c) {
+        for (char s : {'+', '*', '(', ')', '.', '{', '}', '\\'}) {
+            if (c == s) return true;
+        }
+        return false;
+    }
+
+    // std::stoi() of the digits; too large stops compilation like stoi throws
+    constexpr int number(size_t from, size_t to) const {
+        long long n = 0;
+        for (size_t i = from; i < to; i++) {
+            n = n * 10 + (text[i] - '0');
+            if (n > INT_MAX) throw std::out_of_range("StaticPattern: number out of range");
+        }
+        return (int)n;
+    }
+
+    constexpr int add(NodeKind kind, int a = -1, int b = 0, char ch = 0) {
+        if (tree.size == (int)Capacity) throw std::length_error("StaticPattern: tree too large");
+        StaticNode& node = tree.nodes[tree.size];
+        node.kind = kind;
+        node.a = a;
+        node.b = b;
+        node.ch = ch;
+        return tree.size++;
+    }
+
+    constexpr int parseExpr() {
+        int left = parseTerm();
+        if (left < 0) return -1;
+        while (matchChar('+')) {
+            int right = parseTerm();
+            if (right < 0) return -1;
+            left = add(NodeKind::Or, left, right);
+        }
+        return left;
+    }
+
+    constexpr int parseTerm() {
+        int first = -1, last = -1, count = 0;
+        while (true) {
+            int f = parseFactor();
+            if (f < 0) break;
+            if (last < 0) {
+                first = f;
+            } else {
+                tree.nodes[last].next = f;
+            }
+            last = f;
+            count++;
+        }
+        if (count == 0) return -1;
+        return add(NodeKind::Sequence, first, count);
+    }
+
+    constexpr int parseFactor() {
+        if (matchChar('(')) {
+            return parseGroup();
+        }
+        int base = -1;
+        if (!end() && current() == '.') {
+            advance();
+            base = add(NodeKind::Dot);
+        } else if (!end() && !isSpecial(current())) {
+            char c = current();
+            advance();
+            base = add(NodeKind::Character, -1, 0, c);
+        } else {
+            return -1;
+        }
+        return parseSuffixes(base);
+    }
+
+    // a group that doesn't parse stops compilation, as it fails the whole
+    // parse in parsePattern()
+    constexpr int parseGroup() {
+        int e = parseExpr();
+        if (e < 0) throw std::invalid_argument("StaticPattern: expected a character, '.' or '(' in a group");
+        if (!matchChar(')')) throw std::invalid_argument("StaticPattern: missing ')'");
+        return parseSuffixes(add(NodeKind::Group, e, groupCounter++));
+    }
+
+    // parseCount() and then parseIgnoreCase(), each keeping base if absent
+    constexpr int parseSuffixes(int base) {
+        int expanded = parseCount(base);
+        if (expanded >= 0) base = expanded;
+        expanded = parseIgnoreCase(base);
+        if (expanded >= 0) base = expanded;
+        return base;
+    }
+
+    constexpr int parseCount(int base) {
+        if (matchChar('*')) {
+            return add(NodeKind::Star, base);
+        }
+        if (!end() && current() == '{') {
+            return add(NodeKind::Count, base, parseBraces());
+        }
+        return -1;
+    }
+
+    // "{N}" at the '{'; without digits or '}' it stops compilation, as it
+    // fails the whole parse in parsePattern()
+    constexpr int parseBraces() {
+        advance();
+        size_t digits = pos;
+        while (!end() && isDigit(current())) advance();
+        size_t digitsEnd = pos;
+        if (digitsEnd == digits) throw std::invalid_argument("StaticPattern: expected a number after '{'");
+        if (!matchChar('}')) throw std::invalid_argument("StaticPattern: missing '}'");
+        return number(digits, digitsEnd);
+    }
+
+    constexpr int parseIgnoreCase(int base) {
+        if (!end() && current() == '\\') {
+            size_t savedPos = pos;
+            advance();
+            if (!end() && (current() == 'I' || current() == 'i')) {
+                advance();
+                return add(NodeKind::IgnoreCase, base);
+            }
+            pos = savedPos;
+        }
+        return -1;
+    }
+};
+
+/**
+ * StaticPattern
+ *  - the compiled form of the pattern in Source, see the top of this file.
+ *  - all members are static; Captures holds one slot per group like
+ *    MatchScratch::captures(), group 0 = entire match.
+ */
+template <const char* Source>
+class StaticPattern {
+    static constexpr size_t kCapacity = 2 * staticLength(Source) + 1;
+    static constexpr StaticTree<kCapacity> tree = StaticParser<kCapacity>(Source).parse();
+    static_assert(tree.root >= 0, "StaticPattern: the pattern doesn't parse");
+
+public:
+    using Captures = std::array<std::optional<CaptureGroup>, tree.groups>;
+
+    // Group requested with \O{N} / number of groups, as in CompiledPattern.
+    static constexpr int outputGroup() { return tree.output; }
+    static constexpr int groupCount() { return tree.groups; }
+
+    // Match starting exactly at 'start'.
+    static bool matchAt(std::string_view text, size_t start, Captures& captures) {
+        captures.fill(std::nullopt);
+        Context ctx { text, start, captures };
+        if (!matchNode<tree.root, false>(ctx)) return false;
+        captures[0] = CaptureGroup{start, ctx.position, true};
+        return true;
+    }
+
+    // Leftmost match starting at or after 'from'.
+    static bool find(std::string_view text, Captures& captures, size_t from = 0) {
+        for (size_t start = from; start <= text.size(); start++) {
+            if constexpr (firstChar(tree.root) >= 0) {
+                // every match starts with this byte
+                if (start == text.size()) return false;
+                const void* hit = std::memchr(text.data() + start, firstChar(tree.root), text.size() - start);
+                if (!hit) return false;
+                start = (const char*)hit - text.data();
+            }
+            if (matchAt(text, start, captures)) return true;
+        }
+        return false;
+    }
+
+    static bool matches(std::string_view text) {
+        Captures captures;
+        return find(text, captures);
+    }
+
+    // Text of the output group of the leftmost match (empty view if that
+    // group didn't take part), like CompiledPattern::find(text).
+    static std::optional<std::string_view> find(std::string_view text) {
+        Captures captures;
+        if (!find(text, captures)) return std::nullopt;
+        if (tree.output >= tree.groups || !captures[tree.output]) return std::string_view();
+        const CaptureGroup& g = *captures[tree.output];
+        return text.substr(g.startIndex, g.endIndex - g.startIndex);
+    }
+
+private:
+    struct Context {
+        std::string_view input;
+        size_t position;
+        Captures& captures;
+    };
+
+    // The k-th child of Sequence node i.
+    static constexpr int child(int i, int k) {
+        int c = tree.nodes[i].a;
+        while (k-- > 0) c = tree.nodes[c].next;
+        return c;
+    }
+
+    // The byte every match of node i starts with (case-sensitive), or -1.
+    static constexpr int firstChar(int i) {
+        const StaticNode& node = tree.nodes[i];
+        switch (node.kind) {
+        case NodeKind::Character: return (unsigned char)node.ch;
+        case NodeKind::Sequence:
+        case NodeKind::Group:
+        case NodeKind::Star:
+            return node.a >= 0 ? firstChar(node.a) : -1;
+        case NodeKind::Count: return node.b > 0 ? firstChar(node.a) : -1;
+        default: return -1;
+        }
+    }
+
+    // The nodes of Parser.cpp / Nodes.h, one instantiation per node.
+    template <int I, bool Fold>
+    static bool matchNode(Context& ctx) {
+        constexpr StaticNode node = tree.nodes[I];
+        if constexpr (node.kind == NodeKind::Character) {
+            if (ctx.position >= ctx.input.size()) return false;
+            unsigned char c = (unsigned char)ctx.input[ctx.position];
+            constexpr unsigned char ch = (unsigned char)node.ch;
+            if constexpr (Fold && hasOtherCase(ch)) {
+                if (foldLower(c) != foldLower(ch)) return false;
+            } else if (c != ch) {
+                return false;
+            }
+            ctx.position++;
+            return true;
+        } else if constexpr (node.kind == NodeKind::Dot) {
+            if (ctx.position >= ctx.input.size()) return false;
+            ctx.position++;
+            return true;
+        } else if constexpr (node.kind == NodeKind::Sequence) {
+            size_t savedPos = ctx.position;
+            if (!matchChildren<I, Fold>(ctx, std::make_integer_sequence<int, node.b>())) {
+                ctx.position = savedPos;
+                return false;
+            }
+            return true;
+        } else if constexpr (node.kind == NodeKind::Or) {
+            size_t savedPos = ctx.position;
+            if (matchNode<node.a, Fold>(ctx)) return true;
+            ctx.position = savedPos;
+            return matchNode<node.b, Fold>(ctx);
+        } else if constexpr (node.kind == NodeKind::Group) {
+            size_t startPos = ctx.position;
+            if constexpr (node.a >= 0) {
+                if (!matchNode<node.a, Fold>(ctx)) return false;
+            }
+            ctx.captures[node.b] = CaptureGroup{startPos, ctx.position, true};
+            return true;
+        } else if constexpr (node.kind == NodeKind::Star) {
+            // one or more, never giving back; stops on an empty iteration
+            bool any = false;
+            while (true) {
+                size_t savedPos = ctx.position;
+                if (!matchNode<node.a, Fold>(ctx)) {
+                    ctx.position = savedPos;
+                    break;
+                }
+                any = true;
+                if (ctx.position == savedPos) break;
+            }
+            return any;
+        } else if constexpr (node.kind == NodeKind::Count) {
+            size_t savedPos = ctx.position;
+            for (int i = 0; i < node.b; i++) {
+                if (!matchNode<node.a, Fold>(ctx)) {
+                    ctx.position = savedPos;
+                    return false;
+                }
+            }
+            return true;
+        } else {
+            static_assert(node.kind == NodeKind::IgnoreCase, "StaticPattern: unexpected node");
+            return matchNode<node.a, true>(ctx);
+        }
+    }
+
+    template <int I, bool Fold, int... K>
+    static bool matchChildren(Context& ctx, std::integer_sequence<int, K...>) {
+        return (matchNode<child(I, K), Fold>(ctx) && ...);
+    }
+};
+
+#endif // STATIC_PATTERN_H
@@ -0,0 +1,78 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include "AST.h"
+
+/**
+ * Match statistics, for finding out why a pattern is slow.
+ *
+ * Counting is compiled in only with -DSIMPLEPARSER_STATS=1; otherwise every
+ * MATCH_STATS(...) statement disappears and the hot paths are exactly what
+ * they are without it. The structs themselves always exist (so code built
+ * either way can be linked together); without the flag they stay zero.
+ */
+#ifndef SIMPLEPARSER_STATS
+#define SIMPLEPARSER_STATS 0
+#endif
+
+#if SIMPLEPARSER_STATS
+#define MATCH_STATS(...) __VA_ARGS__
+#else
+#define MATCH_STATS(...) ((void)0)
+#endif
+
+// Number of NodeKind values, for the per-kind counters.
+static const int kNodeKinds = (int)NodeKind::DotStar + 1;
+
+/**
+ * MatchStats
+ *  - summed over every search made with one MatchScratch (see
+ *    MatchScratch::stats()), or added up by the caller over several.
+ */
+struct MatchStats {
+    uint64_t searches = 0;        // findMatch() / findMatchInStream() calls
+    uint64_t literalRejects = 0;  // searches ended by a missing required literal
+    uint64_t prefixScans = 0;     // lookups of the required prefix
+    uint64_t suffixScans = 0;     // ... of the required suffix (reverse suffix search)
+    uint64_t candidates = 0;      // start positions tried
+    uint64_t anchoredRejects = 0; // ... ruled out by the anchored DFA
+    uint64_t treeRuns = 0;        // ... handed to the tree matcher
+    uint64_t matches = 0;
+    uint64_t dfaBytes = 0;        // bytes stepped through by the DFAs (and ShiftAnd)
+    uint64_t nodeCalls[kNodeKinds] = {}; // tree matcher, per NodeKind
+    uint64_t backtracks = 0;      // failed Sequence/Count, Or falling back to its right side
+    uint64_t memoHits = 0;        // node results taken from the MatchMemo
+    std::chrono::nanoseconds time{0}; // spent in searches (summed over threads)
+
+    void add(const MatchStats& other) {
+        searches += other.searches;
+        literalRejects += other.literalRejects;
+        prefixScans += other.prefixScans;
+        suffixScans += other.suffixScans;
+        candidates += other.candidates;
+        anchoredRejects += other.anchoredRejects;
+        treeRuns += other.treeRuns;
+        matches += other.matches;
+        dfaBytes += other.dfaBytes;
+        for (int k = 0; k < kNodeKinds; k++) nodeCalls[k] += other.nodeCalls[k];
+        backtracks += other.backtracks;
+        memoHits += other.memoHits;
+        time += other.time;
+    }
+};
+
+// Adds the lifetime of the object to 'total' (use inside MATCH_STATS).
+class StatsTimer {
+public:
+    explicit StatsTimer(std::chrono::nanoseconds& t)
+        : total(t), start(std::chrono::steady_clock::now()) {}
+    ~StatsTimer() { total += std::chrono::steady_clock::now() - start; }
+
+private:
+    std::chrono::nanoseconds& total;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // STATS_H
@@ -0,0 +1,361 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "SimpleParser.h"
+
+#ifdef _WIN32
+#define BENCH_NO_RUSAGE 1
+#else
+#include <sys/resource.h>
+#endif
+
+/**
+ * Benchmarks of the parser and the matchers, printed as one JSON document:
+ *
+ *   bench [--filter=TEXT] [--min-time-ms=N] [--size-mb=N] [--label=TEXT] > results.json
+ *
+ *  - --filter: only run the cases whose name contains TEXT.
+ *  - --min-time-ms: run each case at least this long (default 300).
+ *  - --size-mb: size of the generated log corpus (default 16).
+ *  - --label: copied into the output, e.g. a version to compare against.
+ *
+ * The corpora are generated from a fixed seed with a generator of our own
+ * (the standard distributions differ between libraries), so every machine
+ * and every version searches exactly the same bytes.
+ *
+ * Per case: the time of the first run (cold DFA cache) and the steady-state
+ * throughput over the following runs with the same scratch, the number of
+ * matches (to spot behaviour changes) and the peak RSS of the process after
+ * the case. The peak only grows, so a case that raises it is the one that
+ * needed the memory.
+ */
+
+// Bumped whenever the meaning of a field changes.
+static const int kFormatVersion = 1;
+
+struct Options {
+    std::string filter;
+    std::string label;
+    double minTime = 0.3;       // seconds per case
+    size_t corpusSize = 16 << 20;
+};
+
+// xorshift64*: the same sequence on every platform.
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+    size_t below(size_t n) { return (size_t)(next() % n); }
+};
+
+/**
+ * Log-like lines: a sequence number, a level and words made of syllables.
+ * A few fixed words are mixed in at known rates, so literal patterns have
+ * rare hits ("Waterloo" about every 500 lines, "timeout" about every 200,
+ * now and then in odd case for \I).
+ */
+static std::string logCorpus(size_t size) {
+    static const char* syllables[] = {"ka", "ro", "mi", "ten", "sa", "lu", "vor", "din",
+                                      "pe", "qu", "zan", "tor", "el", "gri", "fo", "ba"};
+    static const char* levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+    Random rng(20250314);
+    std::string text;
+    text.reserve(size + 256);
+    for (size_t line = 0; text.size() < size; line++) {
+        text += std::to_string(100000 + line);
+        text += ' ';
+        text += levels[rng.below(6)];
+        size_t words = 6 + rng.below(10);
+        for (size_t w = 0; w < words; w++) {
+            text += ' ';
+            size_t pick = rng.below(1000);
+            if (pick == 0) {
+                text += "Waterloo";
+            } else if (pick == 1) {
+                text += rng.below(2) ? "WATERLOO" : "waTerLoo";
+            } else if (pick < 5) {
+                text += "timeout";
+            } else {
+                size_t n = 1 + rng.below(3);
+                for (size_t s = 0; s < n; s++) text += syllables[rng.below(16)];
+            }
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+// n a's and a b: holds the required literal of the backtracking worst cases
+// below, so they can't be skipped, but none of them matches.
+static std::string runOfA(size_t n) {
+    return std::string(n, 'a') + "b";
+}
+
+// Random a/b text, which makes "(a+b)*a(a+b){N}" need about 2^N DFA states.
+static std::string abCorpus(size_t size) {
+    Random rng(7);
+    std::string text(size, 'a');
+    for (char& c : text) c = rng.below(2) ? 'a' : 'b';
+    return text;
+}
+
+enum class Driver {
+    Parse,      // parsePattern() only
+    Compile,    // compilePattern(): parse, optimize, flatten, Program, analysis
+    All,        // every match in the corpus (MatchIterator)
+    Lines,      // find() on every line
+    Batch,      // matchesBatch() on the lines, 1024 at a time
+    First       // the leftmost match only (findMatch)
+};
+
+static const char* driverName(Driver d) {
+    switch (d) {
+    case Driver::Parse: return "parse";
+    case Driver::Compile: return "compile";
+    case Driver::All: return "all";
+    case Driver::Lines: return "lines";
+    case Driver::Batch: return "batch";
+    case Driver::First: return "first";
+    }
+    return "";
+}
+
+struct Case {
+    std::string name;
+    std::string family;
+    std::string pattern;
+    Driver driver;
+    const std::string* corpus;  // null for Parse / Compile
+};
+
+struct Result {
+    size_t bytes = 0;           // per run: input size (or pattern bytes)
+    size_t runs = 0;
+    double seconds = 0;         // of the steady-state runs
+    double firstSeconds = 0;
+    size_t matches = 0;
+    long peakKB = 0;
+};
+
+static long peakRSS() {
+#ifdef BENCH_NO_RUSAGE
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024; // bytes there
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// The patterns used by the parse / compile cases, one of each family.
+static const std::vector<std::string>& parsePatterns() {
+    static const std::vector<std::string> patterns = {
+        "Waterloo", "ERROR .*timeout", "((ka+ro)(mi+ten))*sa", "(ka+ro){3}x",
+        "(waterloo)\\I", "Waterloo+Toronto+Montreal+Ottawa",
+        "promise to (Love+Hate)\\I you\\O{1}", "((a+b)*(c+d){2})*(e.f)\\I",
+    };
+    return patterns;
+}
+
+// One run of the case; returns the number of matches (or patterns handled).
+static size_t runOnce(const Case& c, const CompiledPattern* pattern, MatchScratch& scratch) {
+    switch (c.driver) {
+    case Driver::Parse: {
+        size_t n = 0;
+        for (const std::string& p : parsePatterns()) {
+            int outputGroup = 0;
+            int groups = 1;
+            n += parsePattern(p, outputGroup, groups) != nullptr;
+        }
+        return n;
+    }
+    case Driver::Compile: {
+        size_t n = 0;
+        for (const std::string& p : parsePatterns()) n += compilePattern(p) != nullptr;
+        return n;
+    }
+    case Driver::All: {
+        size_t n = 0;
+        MatchIterator it(*pattern, *c.corpus, scratch);
+        while (it.next()) n++;
+        return n;
+    }
+    case Driver::Lines: {
+        std::string_view text = *c.corpus;
+        size_t n = 0;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            const char* nl = (const char*)std::memchr(text.data() + pos, '\n', text.size() - pos);
+            size_t end = nl ? (size_t)(nl - text.data()) : text.size();
+            n += pattern->find(text.substr(pos, end - pos), scratch);
+            pos = end + 1;
+        }
+        return n;
+    }
+    case Driver::Batch: {
+        std::string_view text = *c.corpus;
+        RecordBatch batch;
+        batch.data = text;
+        std::vector<char> matched;
+        size_t n = 0;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            const char* nl = (const char*)std::memchr(text.data() + pos, '\n', text.size() - pos);
+            size_t end = nl ? (size_t)(nl - text.data()) : text.size();
+            batch.add(pos, end - pos);
+            pos = end + 1;
+            if (batch.size() == 1024 || pos >= text.size()) {
+                n += pattern->matchesBatch(batch, scratch, matched);
+                batch.clear();
+            }
+        }
+        return n;
+    }
+    case Driver::First:
+        return findMatch(*pattern, *c.corpus, scratch) != std::string_view::npos;
+    }
+    return 0;
+}
+
+static Result runCase(const Case& c, const Options& opts) {
+    using Clock = std::chrono::steady_clock;
+    Result r;
+    std::shared_ptr<const CompiledPattern> pattern;
+    if (c.corpus) {
+        pattern = compilePattern(c.pattern);
+        r.bytes = c.corpus->size();
+    } else {
+        for (const std::string& p : parsePatterns()) r.bytes += p.size();
+    }
+    MatchScratch scratch;
+
+    auto start = Clock::now();
+    r.matches = runOnce(c, pattern.get(), scratch);
+    r.firstSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    do {
+        runOnce(c, pattern.get(), scratch);
+        r.runs++;
+        r.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (r.seconds < opts.minTime);
+
+    r.peakKB = peakRSS();
+    return r;
+}
+
+static std::string jsonString(std::string_view s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            static const char* hex = "0123456789abcdef";
+            out += "\\u00";
+            out += hex[(c >> 4) & 0xf];
+            out += hex[c & 0xf];
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static bool parseArgs(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 9, "--filter=") == 0) {
+            opts.filter = arg.substr(9);
+        } else if (arg.compare(0, 8, "--label=") == 0) {
+            opts.label = arg.substr(8);
+        } else if (arg.compare(0, 14, "--min-time-ms=") == 0) {
+            opts.minTime = std::atof(arg.c_str() + 14) / 1000.0;
+        } else if (arg.compare(0, 10, "--size-mb=") == 0) {
+            long mb = std::atol(arg.c_str() + 10);
+            if (mb <= 0) return false;
+            opts.corpusSize = (size_t)mb << 20;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::cerr << "Usage: bench [--filter=TEXT] [--min-time-ms=N] [--size-mb=N] [--label=TEXT]\n";
+        return EXIT_FAILURE;
+    }
+
+    const std::string logs = logCorpus(opts.corpusSize);
+    const std::string as = runOfA(4096);
+    const std::string ab = abCorpus(256 << 10);
+
+    const std::vector<Case> cases = {
+        {"parse", "parser", "", Driver::Parse, nullptr},
+        {"compile", "parser", "", Driver::Compile, nullptr},
+
+        {"literal/all", "literal", "Waterloo", Driver::All, &logs},
+        {"literal/miss", "literal", "Zanzibar", Driver::First, &logs},
+        {"literal/lines", "literal", "timeout", Driver::Lines, &logs},
+        {"dotstar/lines", "dotstar", "ERROR .*", Driver::Lines, &logs},
+        {"dotstar/miss", "dotstar", "ERROR .*Zanzibar", Driver::Lines, &logs},
+        {"batch/literal", "batch", "timeout", Driver::Batch, &logs},
+        {"batch/dotstar", "batch", "ERROR .*", Driver::Batch, &logs},
+        {"batch/groups", "batch", "((ka+ro)(mi+ten))*sa", Driver::Batch, &logs},
+        {"groups/all", "groups", "((ka+ro)(mi+ten))*sa", Driver::All, &logs},
+        {"groups/output", "groups", "(ERROR+WARN) (ka(ro+mi)*)\\O{2}", Driver::All, &logs},
+        {"count/all", "count", "(ka+ro){3}x", Driver::All, &logs},
+        {"count/literal", "count", "ka{2}", Driver::All, &logs},
+        {"ignorecase/all", "ignorecase", "(waterloo)\\I", Driver::All, &logs},
+        {"ignorecase/class", "ignorecase", "(w+x+y+z)\\Iaterloo", Driver::All, &logs},
+        {"alternation/all", "alternation", "Waterloo+Toronto+Montreal+Ottawa", Driver::All, &logs},
+        {"alternation/class", "alternation", "(k+r+m+t)(a+o+i+e)(k+r+m+t)(a+o+i+e)x", Driver::All, &logs},
+
+        {"worst/star-groups", "pathological", "(a)*ab", Driver::All, &as},
+        {"worst/star-memo", "pathological", "a*ab", Driver::All, &as},
+        {"worst/nested-star", "pathological", "((a*)(a*))*ab", Driver::All, &as},
+        {"worst/alternation", "pathological", "(a+aa)*ab", Driver::All, &as},
+        {"worst/dfa-states", "pathological", "(a+b)*a(a+b){14}c", Driver::First, &ab},
+    };
+
+    std::cout << "{\n  \"format\": " << kFormatVersion << ",\n  \"label\": " << jsonString(opts.label)
+              << ",\n  \"corpus_bytes\": " << logs.size() << ",\n  \"cases\": [";
+    bool first = true;
+    for (const Case& c : cases) {
+        if (!opts.filter.empty() && c.name.find(opts.filter) == std::string::npos) continue;
+        Result r = runCase(c, opts);
+        double perRun = r.seconds / r.runs;
+
+        std::cout << (first ? "\n" : ",\n") << "    {\"name\": " << jsonString(c.name)
+                  << ", \"family\": " << jsonString(c.family)
+                  << ", \"pattern\": " << jsonString(c.pattern)
+                  << ", \"driver\": " << jsonString(driverName(c.driver))
+                  << ", \"bytes\": " << r.bytes << ", \"runs\": " << r.runs
+                  << ", \"ns_per_run\": " << (uint64_t)(perRun * 1e9)
+                  << ", \"mb_per_s\": " << (r.bytes / perRun) / (1 << 20)
+                  << ", \"first_run_ns\": " << (uint64_t)(r.firstSeconds * 1e9)
+                  << ", \"matches\": " << r.matches
+                  << ", \"peak_rss_kb\": " << r.peakKB << "}";
+        std::cout.flush();
+        first = false;
+    }
+    std::cout << "\n  ]\n}\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,703 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "Nodes.h"
+#include "SimpleParser.h"
+
+/**
+ * Checks of the search drivers against the tree matcher (POSIX only):
+ *
+ *   check [--seed=N] [--cases=N]
+ *
+ *  - search: random patterns and inputs over a small alphabet (with
+ *    newlines, *, {N}, \I, groups and \O{N}). The reference is the parsed,
+ *    unoptimized AST tried at every start, as the first version of match
+ *    did. findMatch() on the buffer and on a mapped file, findMatchInStream()
+ *    over a pipe read in chunks of a few bytes, MatchIterator and the stream
+ *    loop of --all, find() / matches() / matchesBatch() per line (--lines)
+ *    and the same pattern loaded back from a pattern file must all give the
+ *    same leftmost match and output group. Whatever engine the plan picks
+ *    (DFA, ShiftAnd, OnePass, reverse suffix, memo) is covered this way.
+ *  - engines: a fixed pattern for every engine of the planner, which must
+ *    still be planned that way, through the same search checks.
+ *  - threads: findMatchParallel() on inputs of a few chunks, with a case
+ *    placed across a chunk boundary, against findMatch().
+ *  - pattern files: a file truncated at any length, or with a header byte
+ *    changed, must be rejected with a reason; with any other byte changed
+ *    it must be rejected or load into patterns that can be run. Build with
+ *    -fsanitize=address to also see reads out of bounds.
+ *  - rejects: patterns with something left over or a '{' that isn't
+ *    "{N}" fail to compile, at the right offset.
+ *  - series: every start of a long text tried with patterns whose anchored
+ *    runs alternate between states, under a step limit linear in the text.
+ *  - limits: searches whose automaton scans run over a step limit stop
+ *    and report it (scratch.aborted()) instead of answering "no match".
+ *  - allocations: searches with a warm scratch don't allocate.
+ *
+ * Prints the first differences and exits with 1 if there were any.
+ */
+
+struct Options {
+    uint64_t seed = 1;
+    size_t cases = 2000;
+};
+
+// Every operator new of the process, for the allocation check.
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// xorshift64*: the same sequence on every platform.
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+    size_t below(size_t n) { return (size_t)(next() % n); }
+    bool chance(size_t percent) { return below(100) < percent; }
+};
+
+static std::string randomExpr(Random& rng, int depth);
+
+static std::string randomFactor(Random& rng, int depth) {
+    std::string f;
+    if (depth < 3 && rng.chance(25)) {
+        f = "(" + randomExpr(rng, depth + 1) + ")";
+    } else if (rng.chance(20)) {
+        f = ".";
+    } else {
+        f = std::string(1, "abABx"[rng.below(5)]);
+    }
+    size_t r = rng.below(100);
+    if (r < 20) {
+        f += "*";
+    } else if (r < 40) {
+        f += "{" + std::to_string(rng.below(7)) + "}";
+    }
+    if (rng.chance(15)) f += "\\I";
+    return f;
+}
+
+static std::string randomExpr(Random& rng, int depth) {
+    std::string e;
+    size_t terms = 1 + rng.below(depth ? 2 : 3);
+    for (size_t t = 0; t < terms; t++) {
+        if (t > 0) e += "+";
+        size_t factors = 1 + rng.below(3);
+        for (size_t k = 0; k < factors; k++) e += randomFactor(rng, depth);
+    }
+    return e;
+}
+
+static std::string randomPattern(Random& rng) {
+    std::string p = randomExpr(rng, 0);
+    if (rng.chance(30)) p += "\\O{" + std::to_string(rng.below(4)) + "}";
+    return p;
+}
+
+static std::string randomText(Random& rng) {
+    static const size_t lengths[] = {14, 60, 200};
+    static const char alphabet[] = "abAB x\n\n";
+    size_t n = rng.below(lengths[rng.below(3)] + 1);
+    std::string text;
+    for (size_t i = 0; i < n; i++) text += alphabet[rng.below(sizeof alphabet - 1)];
+    return text;
+}
+
+/**
+ * Reference
+ *  - the unoptimized AST of a pattern, matched by Nodes.h at every start.
+ *  - each search gets a step budget; a case that runs over it is skipped
+ *    (the tree matcher without the memo is exponential on some patterns).
+ */
+struct Reference {
+    std::shared_ptr<ASTNode> ast;
+    int outputGroup = 0;
+    int groupCount = 1;
+    MatchBudget budget;
+
+    // Leftmost match at or after 'from' into 'captures'; false if none or
+    // over the budget (then over() is set).
+    bool find(std::string_view text, size_t from, std::vector<std::optional<CaptureGroup>>& captures) {
+        budget.start();
+        for (size_t start = from; start <= text.size(); start++) {
+            MatchContext ctx { text, start, {}, false };
+            ctx.captures.resize(groupCount, std::nullopt);
+            ctx.budget = &budget;
+            if (ast->match(ctx) && !budget.exceeded()) {
+                if (!ctx.captures[0].has_value()) ctx.captures[0] = CaptureGroup{start, ctx.position, true};
+                captures = ctx.captures;
+                return true;
+            }
+            if (budget.exceeded()) return false;
+        }
+        return false;
+    }
+    bool over() const { return budget.exceeded(); }
+};
+
+// One match as text: group 0 and the output group (with their offsets
+// unless the input is a stream), so different drivers can be compared.
+static std::string describe(std::string_view text, const std::vector<std::optional<CaptureGroup>>& captures,
+                            int outputGroup, bool offsets = true)
+{
+    std::string s;
+    for (int g : {0, outputGroup}) {
+        if (g >= (int)captures.size() || !captures[g].has_value()) {
+            s += "[-]";
+            continue;
+        }
+        const CaptureGroup& c = *captures[g];
+        s += "[";
+        if (offsets) s += std::to_string(c.startIndex) + "," + std::to_string(c.endIndex) + ":";
+        s += std::string(text.substr(c.startIndex, c.endIndex - c.startIndex)) + "]";
+    }
+    return s;
+}
+
+static std::string describeAll(const std::vector<std::string>& matches) {
+    std::string s;
+    for (const std::string& m : matches) s += m;
+    return s.empty() ? "no match" : s;
+}
+
+static std::string quoted(std::string_view text) {
+    std::string s = "\"";
+    for (char c : text.substr(0, 80)) s += c == '\n' ? std::string("\\n") : std::string(1, c);
+    return s + (text.size() > 80 ? "...\"" : "\"");
+}
+
+struct Failures {
+    size_t count = 0;
+
+    void report(const std::string& what, const std::string& pattern, std::string_view text,
+                const std::string& expected, const std::string& got)
+    {
+        if (++count > 10) return;
+        std::cerr << "FAIL " << what << ": pattern " << quoted(pattern) << " text " << quoted(text)
+                  << "\n  expected " << expected << "\n  got      " << got << "\n";
+    }
+};
+
+// Path of a new temporary file holding 'contents'; empty on failure.
+static std::string temporaryFile(std::string_view contents) {
+    char path[] = "/tmp/simpleparser-check-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return std::string();
+    bool ok = write(fd, contents.data(), contents.size()) == (ssize_t)contents.size();
+    close(fd);
+    return ok ? std::string(path) : std::string();
+}
+
+// Every match of 'pattern' in 'text' from findMatchInStream() on a pipe
+// read 'chunk' bytes at a time, as match --all does (only the first one
+// without 'all').
+static std::vector<std::string> streamMatches(const CompiledPattern& pattern, std::string_view text,
+                                              size_t chunk, bool all)
+{
+    std::vector<std::string> found;
+    int fds[2];
+    if (pipe(fds) != 0) return found;
+    std::thread writer([&]() {
+        for (size_t done = 0; done < text.size(); ) {
+            ssize_t n = write(fds[1], text.data() + done, text.size() - done);
+            if (n <= 0) break;
+            done += n;
+        }
+        close(fds[1]);
+    });
+    {
+        ChunkReader reader(fds[0], chunk);
+        MatchScratch scratch;
+        size_t from = 0;
+        while (findMatchInStream(pattern, reader, scratch, from)) {
+            found.push_back(describe(reader.view(), scratch.captures(), pattern.outputGroup(), false));
+            if (!all) break;
+            const CaptureGroup& whole = *scratch.captures()[0];
+            from = whole.endIndex > whole.startIndex ? whole.endIndex : whole.startIndex + 1;
+        }
+        while (reader.refill(0)) {}     // let the writer finish
+    }
+    writer.join();
+    close(fds[0]);
+    return found;
+}
+
+// Offsets stripped from describe() output, to compare with a stream.
+static std::vector<std::string> withoutOffsets(std::string_view text, const std::vector<std::vector<std::optional<CaptureGroup>>>& all,
+                                               int outputGroup)
+{
+    std::vector<std::string> out;
+    for (const auto& captures : all) out.push_back(describe(text, captures, outputGroup, false));
+    return out;
+}
+
+/**
+ * One random pattern against one random text through every driver.
+ * Returns false if the reference ran over its budget (case skipped).
+ */
+static bool checkSearch(const std::string& source, std::string_view text, Random& rng, Failures& failures) {
+    auto pattern = compilePattern(source);
+    Reference ref;
+    ref.ast = parsePattern(source, ref.outputGroup, ref.groupCount);
+    if (!pattern || !ref.ast) {
+        if (pattern || ref.ast) failures.report("parse", source, text, ref.ast ? "parsed" : "error",
+                                                pattern ? "parsed" : "error");
+        return true;
+    }
+    MatchLimits refLimits;
+    refLimits.maxSteps = 2000000;
+    ref.budget.setLimits(refLimits);
+    int output = pattern->outputGroup();
+
+    // all matches of the reference, resumed as MatchIterator does
+    std::vector<std::vector<std::optional<CaptureGroup>>> expected;
+    std::vector<std::string> expectedText;
+    for (size_t from = 0; from <= text.size(); ) {
+        std::vector<std::optional<CaptureGroup>> captures;
+        if (!ref.find(text, from, captures)) break;
+        expected.push_back(captures);
+        expectedText.push_back(describe(text, captures, output));
+        const CaptureGroup& whole = *captures[0];
+        from = whole.endIndex > whole.startIndex ? whole.endIndex : whole.startIndex + 1;
+    }
+    if (ref.over()) return false;
+    std::string first = expectedText.empty() ? "no match" : expectedText[0];
+
+    MatchScratch scratch;
+    size_t at = findMatch(*pattern, text, scratch);
+    std::string got = at == std::string_view::npos ? "no match" : describe(text, scratch.captures(), output);
+    if (got != first) failures.report("findMatch", source, text, first, got);
+
+    std::vector<std::string> all;
+    MatchIterator it(*pattern, text, scratch);
+    while (it.next()) all.push_back(describe(text, scratch.captures(), output));
+    if (all != expectedText) failures.report("MatchIterator", source, text, describeAll(expectedText), describeAll(all));
+
+    std::string path = temporaryFile(text);
+    if (!path.empty()) {
+        {
+            MappedFile file(path);
+            std::string_view mapped = file.ok() ? file.view() : std::string_view();
+            at = findMatch(*pattern, mapped, scratch);
+            got = at == std::string_view::npos ? "no match" : describe(mapped, scratch.captures(), output);
+            if (got != first) failures.report("findMatch on a mapped file", source, text, first, got);
+        }
+        std::remove(path.c_str());
+    }
+
+    size_t chunk = 1 + rng.below(8);
+    std::vector<std::string> noOffsets = withoutOffsets(text, expected, output);
+    std::vector<std::string> streamed = streamMatches(*pattern, text, chunk, false);
+    std::vector<std::string> firstOnly(noOffsets.begin(), noOffsets.begin() + std::min<size_t>(1, noOffsets.size()));
+    if (streamed != firstOnly) {
+        failures.report("findMatchInStream, chunks of " + std::to_string(chunk), source, text,
+                        describeAll(firstOnly), describeAll(streamed));
+    }
+    streamed = streamMatches(*pattern, text, chunk, true);
+    if (streamed != noOffsets) {
+        failures.report("findMatchInStream --all, chunks of " + std::to_string(chunk), source, text,
+                        describeAll(noOffsets), describeAll(streamed));
+    }
+
+    // --lines: every line on its own, one by one and as a batch
+    RecordBatch batch;
+    batch.data = text;
+    std::vector<char> expectedLines;
+    for (size_t begin = 0; begin <= text.size(); ) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string_view::npos) end = text.size();
+        if (end == text.size() && begin == end && begin > 0) break;
+        std::string_view line = text.substr(begin, end - begin);
+        std::vector<std::optional<CaptureGroup>> captures;
+        bool found = ref.find(line, 0, captures);
+        if (ref.over()) return false;
+        std::string want = found ? describe(line, captures, output) : "no match";
+        got = pattern->find(line, scratch) ? describe(line, scratch.captures(), output) : "no match";
+        if (got != want) failures.report("find on a line", source, line, want, got);
+        if (pattern->matches(line, scratch) != found) {
+            failures.report("matches on a line", source, line, found ? "match" : "no match",
+                            found ? "no match" : "match");
+        }
+        batch.add(begin, line.size());
+        expectedLines.push_back(found);
+        begin = end + 1;
+    }
+    std::vector<char> matched;
+    pattern->matchesBatch(batch, scratch, matched);
+    for (size_t k = 0; k < batch.size(); k++) {
+        if (matched[k] != expectedLines[k]) {
+            failures.report("matchesBatch, record " + std::to_string(k), source, batch.record(k),
+                            expectedLines[k] ? "match" : "no match", matched[k] ? "match" : "no match");
+        }
+    }
+
+    // the same pattern through a pattern file
+    std::vector<SavedPattern> saved { {pattern, 0} }, loaded;
+    std::string error;
+    if (!deserializePatterns(serializePatterns(saved), loaded, &error) || loaded.size() != 1) {
+        failures.report("pattern file", source, text, "loaded", error);
+    } else {
+        MatchScratch loadedScratch;
+        at = findMatch(*loaded[0].pattern, text, loadedScratch);
+        got = at == std::string_view::npos ? "no match" : describe(text, loadedScratch.captures(), output);
+        if (got != first) failures.report("findMatch with a loaded pattern", source, text, first, got);
+    }
+    return true;
+}
+
+/**
+ * findMatchParallel() with 3 threads on a few chunks of filler, with a
+ * random text across the boundary of the first or the second chunk.
+ */
+static void checkThreads(const std::string& source, std::string_view piece, Random& rng, Failures& failures) {
+    auto pattern = compilePattern(source);
+    if (!pattern) return;
+    size_t chunk = chunkSizeFor(3 << 20, 3);
+    std::string text(3 << 20, 'y');
+    size_t boundary = chunk * (1 + rng.below(2));
+    size_t at = boundary - std::min(boundary, rng.below(piece.size() + 1));
+    text.replace(at, piece.size(), piece);
+
+    MatchLimits limits;
+    limits.maxSteps = 50000000;
+    MatchScratch scratch, parallelScratch;
+    scratch.setLimits(limits);
+    parallelScratch.setLimits(limits);
+    int output = pattern->outputGroup();
+    size_t pos = findMatch(*pattern, text, scratch);
+    if (scratch.aborted()) return;
+    std::string want = pos == std::string_view::npos ? "no match" : describe(text, scratch.captures(), output);
+    pos = findMatchParallel(*pattern, text, parallelScratch, 3);
+    if (parallelScratch.aborted()) return;
+    std::string got = pos == std::string_view::npos ? "no match" : describe(text, parallelScratch.captures(), output);
+    if (got != want) {
+        failures.report("findMatchParallel at " + std::to_string(at), source, piece, want, got);
+    }
+}
+
+// Runs every loaded pattern on a short text, under limits so that a
+// damaged but valid pattern can't run away.
+static void runLoaded(const std::vector<SavedPattern>& loaded) {
+    static const std::string text = "abAB x ab\nBA xxab aaaa\n\nbbbb AbaB";
+    MatchLimits limits;
+    limits.maxSteps = 100000;
+    for (const SavedPattern& p : loaded) {
+        MatchScratch scratch;
+        scratch.setLimits(limits);
+        findMatch(*p.pattern, text, scratch);
+        p.pattern->matches(text, scratch);
+        MatchIterator it(*p.pattern, text, scratch);
+        for (int n = 0; n < 100 && it.next(); n++) it.group(p.pattern->outputGroup());
+    }
+}
+
+static void checkPatternFiles(Failures& failures) {
+    static const char* sources[] = {
+        "abc", "(a+b)*c", "x(ab)*\\Iy\\O{1}", "a{3}b*(A+a)", ".*x.*", "(a*)*b",
+        "((ab)+(ba))*\\O{2}", "promise to (Love+Hate)\\I you",
+    };
+    std::vector<SavedPattern> saved;
+    uint64_t tag = 0;
+    for (const char* source : sources) saved.push_back({compilePattern(source), ++tag});
+    std::string data = serializePatterns(saved);
+
+    std::vector<SavedPattern> loaded;
+    std::string error;
+    if (!deserializePatterns(data, loaded, &error) || loaded.size() != saved.size()) {
+        failures.report("deserializePatterns", "", "", "all patterns", error);
+        return;
+    }
+    for (size_t k = 0; k < saved.size(); k++) {
+        if (loaded[k].tag != saved[k].tag || loaded[k].pattern->source() != saved[k].pattern->source()) {
+            failures.report("deserializePatterns", saved[k].pattern->source(), "", "same source and tag",
+                            loaded[k].pattern->source());
+        }
+    }
+
+    for (size_t length = 0; length < data.size(); length++) {
+        loaded.clear();
+        error.clear();
+        if (deserializePatterns(std::string_view(data).substr(0, length), loaded, &error) || error.empty()) {
+            failures.report("truncated pattern file", "", "", "rejected with a reason",
+                            "accepted at " + std::to_string(length) + " of " + std::to_string(data.size()));
+        }
+    }
+
+    std::string damaged = data;
+    for (size_t i = 0; i < data.size(); i++) {
+        for (unsigned char change : {0x01, 0x80, 0xff}) {
+            damaged[i] = (char)(data[i] ^ change);
+            loaded.clear();
+            error.clear();
+            bool ok = deserializePatterns(damaged, loaded, &error);
+            if (ok) {
+                runLoaded(loaded);
+            } else if (error.empty()) {
+                failures.report("damaged pattern file", "", "", "a reason", "none at " + std::to_string(i));
+            }
+            if (ok && i < 16) {
+                failures.report("damaged pattern file header", "", "", "rejected",
+                                "accepted with byte " + std::to_string(i) + " changed");
+            }
+        }
+        damaged[i] = data[i];
+    }
+
+    // and through loadPatterns()
+    std::string path = temporaryFile(std::string_view(data).substr(0, data.size() / 2));
+    if (!path.empty()) {
+        if (loadPatterns(path, loaded, &error)) {
+            failures.report("loadPatterns", "", "", "truncated file rejected", "accepted");
+        }
+        if (!savePatterns(path, saved) || !loadPatterns(path, loaded, &error) || loaded.size() != saved.size()) {
+            failures.report("savePatterns / loadPatterns", "", "", "all patterns", error);
+        }
+        std::remove(path.c_str());
+    }
+    if (loadPatterns("/nonexistent/simpleparser-check", loaded, &error) || error.empty()) {
+        failures.report("loadPatterns", "", "", "missing file rejected with a reason", "accepted");
+    }
+}
+
+/**
+ * Patterns that don't parse as a whole: compilePattern() must reject them,
+ * saying where, rather than drop what it couldn't read.
+ */
+static void checkRejects(Failures& failures) {
+    static const struct { const char* source; size_t position; } cases[] = {
+        { "a)b", 1 }, { "a{2}{3}", 4 }, { "ab\\Q", 2 }, { "ab\\O{x}", 4 }, { "a\\O{2}b", 6 },
+        { "abc{x}", 3 }, { "abc{", 3 }, { "a{}", 1 }, { "(ab){12", 4 }, { "a\\O{}", 3 }, { "a\\O{1", 3 },
+        { "(a+)b", 3 }, { "()", 1 }, { "a()", 2 }, { "(+a)", 1 }, { "((a+))", 4 }, { "x(a", 3 }, { "x(a+", 4 },
+        { "(a{x}", 2 }, { "(a(b)", 5 },
+    };
+    for (const auto& c : cases) {
+        ParseError error;
+        auto pattern = compilePattern(c.source, &error);
+        std::string got = pattern ? "parsed" : "error at " + std::to_string(error.position);
+        std::string want = "error at " + std::to_string(c.position);
+        if (got != want) failures.report("reject", c.source, "", want, got);
+    }
+}
+
+/**
+ * A long text that only matches at its end, with patterns whose anchored
+ * runs are in a different state at a position depending on where they
+ * started (odd or even for "(..)*"). Every start is tried, so the series
+ * of anchored runs has to share its work between them: the search must fit
+ * in a step limit of a few dozen steps per byte.
+ */
+static void checkSeries(Failures& failures) {
+    static const char* sources[] = { "(..)*B+ax", "(...)*B+ax", "(.{7})*B+ax", "(.{12})*(B+C)+ax" };
+    std::string text(1 << 20, 'y');
+    text += "axx";
+    MatchLimits limits;
+    limits.maxSteps = 64 * text.size();
+    for (const char* source : sources) {
+        auto pattern = compilePattern(source);
+        MatchScratch scratch;
+        scratch.setLimits(limits);
+        size_t at = findMatch(*pattern, text, scratch);
+        std::string got = scratch.aborted() ? "over the step limit"
+                        : at == std::string_view::npos ? "no match"
+                        : describe(text, scratch.captures(), pattern->outputGroup());
+        std::string want = "[" + std::to_string(1 << 20) + "," + std::to_string((1 << 20) + 2) + ":ax]";
+        if (got != want + want) failures.report("series of anchored runs", source, "y...yaxx", want + want, got);
+    }
+}
+
+/**
+ * Long texts without a match that ShiftAnd and the DFA have to scan to the
+ * end, searched for with findMatch() and matches() and as a record of a
+ * batch: under a step limit far below their length each search must stop
+ * and say so, and without limits it must get through to "no match". The
+ * next search with the same scratch starts over.
+ */
+struct LimitCase {
+    const char* source;
+    std::string text;
+};
+
+static std::vector<LimitCase> limitCases() {
+    std::string shiftAnd, dfa;
+    while (shiftAnd.size() < (1 << 20)) shiftAnd += "xy";
+    while (dfa.size() < (1 << 20)) dfa += "c" + std::string(69, 'a');
+    return {
+        { "(a+b)(c+d)", shiftAnd },
+        { "(a+b)*c(a+b){70}(d+e)", dfa },
+    };
+}
+
+static const MatchLimits kTightLimits{ 10000, std::chrono::milliseconds(0) };
+
+// "match", "no match" or "over the limits" for an answer and its scratch.
+static std::string outcome(bool found, const MatchScratch& scratch) {
+    return scratch.aborted() ? "over the limits" : found ? "match" : "no match";
+}
+
+static void checkLimits(Failures& failures) {
+    for (const LimitCase& c : limitCases()) {
+        auto pattern = compilePattern(c.source);
+        MatchScratch scratch;
+        bool found = findMatch(*pattern, c.text, scratch) != std::string_view::npos;
+        if (outcome(found, scratch) != "no match") {
+            failures.report("findMatch() without limits", c.source, "...", "no match", outcome(found, scratch));
+        }
+        scratch.setLimits(kTightLimits);
+        found = pattern->matches(c.text, scratch);
+        if (outcome(found, scratch) != "over the limits") {
+            failures.report("matches() with limits", c.source, "...", "over the limits", outcome(found, scratch));
+        }
+        found = findMatch(*pattern, c.text, scratch) != std::string_view::npos;
+        if (outcome(found, scratch) != "over the limits") {
+            failures.report("findMatch() with limits", c.source, "...", "over the limits", outcome(found, scratch));
+        }
+        found = pattern->matches("xy", scratch);
+        if (outcome(found, scratch) != "no match") {
+            failures.report("matches() after running over", c.source, "xy", "no match", outcome(found, scratch));
+        }
+
+        // matchesBatch() with the text as one of its records (--lines)
+        RecordBatch batch;
+        batch.data = c.text;
+        batch.add(0, c.text.size());
+        std::vector<char> matched;
+        bool aborted = false;
+        pattern->matchesBatch(batch, scratch, matched, &aborted);
+        std::string got = aborted ? "over the limits" : matched[0] ? "match" : "no match";
+        if (got != "over the limits") failures.report("matchesBatch() with limits", c.source, "...", "over the limits", got);
+    }
+}
+
+/**
+ * The second round of the same searches with the same scratch must not
+ * allocate: the DFA states, capture slots and batch arrays are all there.
+ */
+static void checkAllocations(Failures& failures) {
+    static const char* sources[] = {
+        "Waterloo", "(a+b)*cd", "x(ab)*\\Iy\\O{1}", "a{3}b*(A+a)", "(a*)*b", "time(out)\\I",
+    };
+    std::string text;
+    Random rng(7);
+    for (int line = 0; line < 200; line++) {
+        for (int n = 0; n < 40; n++) text += "abcdxy tiMEoUT "[rng.below(15)];
+        text += line % 50 == 0 ? "Waterloo abcd\n" : "\n";
+    }
+    RecordBatch batch;
+    batch.data = text;
+    for (size_t begin = 0; begin < text.size(); ) {
+        size_t end = text.find('\n', begin);
+        batch.add(begin, end - begin);
+        begin = end + 1;
+    }
+    for (const char* source : sources) {
+        auto pattern = compilePattern(source);
+        MatchScratch scratch;
+        std::vector<char> matched;
+        uint64_t before = 0;
+        for (int round = 0; round < 2; round++) {
+            if (round == 1) before = allocations;
+            findMatch(*pattern, text, scratch);
+            MatchIterator it(*pattern, text, scratch);
+            while (it.next()) {}
+            for (size_t k = 0; k < batch.size(); k++) pattern->find(batch.record(k), scratch);
+            pattern->matchesBatch(batch, scratch, matched);
+        }
+        if (allocations != before) {
+            failures.report("allocations", source, "", "0", std::to_string(allocations - before));
+        }
+    }
+}
+
+/**
+ * One pattern per engine the planner can pick (see Plan.h), and per
+ * forward scan: each must still get that plan, so that a change to the
+ * planner can't leave an engine out of the random cases unnoticed, and
+ * is checked against the reference on random texts long enough for ".{70}".
+ */
+static void checkEngines(Random& rng, Failures& failures) {
+    static const struct { const char* source; MatchEngine engine; bool bitScan; } cases[] = {
+        { "ab x", MatchEngine::Literal, false },
+        { "(a+b)x", MatchEngine::BitParallel, true },
+        { "(a+b)*x", MatchEngine::DFA, true },
+        { "(a+b)*x.{70}", MatchEngine::DFA, false },
+        { "(a)(b*)x\\O{2}", MatchEngine::OnePass, true },
+        { "(.){300}\\O{1}", MatchEngine::DFAThenTree, false },
+        { "(a+ab)(b*)\\O{2}", MatchEngine::Backtrack, true },
+    };
+    for (const auto& c : cases) {
+        const MatchPlan& plan = compilePattern(c.source)->plan();
+        if (plan.engine != c.engine || (c.engine != MatchEngine::Literal && plan.bitScan != c.bitScan)) {
+            std::string want = std::string(engineName(c.engine)) + (c.bitScan ? ", ShiftAnd scan" : "");
+            std::string got = std::string(engineName(plan.engine)) + (plan.bitScan ? ", ShiftAnd scan" : "");
+            failures.report("plan", c.source, "", want, got);
+        }
+        for (int n = 0; n < 30; n++) {
+            std::string text;
+            for (size_t parts = 1 + rng.below(4); parts > 0; parts--) text += randomText(rng);
+            checkSearch(c.source, text, rng, failures);
+        }
+    }
+}
+
+static bool parseArgs(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 7, "--seed=") == 0) {
+            opts.seed = std::strtoull(arg.c_str() + 7, nullptr, 10);
+        } else if (arg.compare(0, 8, "--cases=") == 0) {
+            opts.cases = std::strtoull(arg.c_str() + 8, nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::cerr << "Usage: check [--seed=N] [--cases=N]\n";
+        return 2;
+    }
+    Failures failures;
+    Random rng(opts.seed);
+    size_t skipped = 0;
+    for (size_t n = 0; n < opts.cases; n++) {
+        std::string source = randomPattern(rng);
+        std::string text = randomText(rng);
+        if (!checkSearch(source, text, rng, failures)) skipped++;
+        if (n % 20 == 0) checkThreads(source, text, rng, failures);
+    }
+    checkEngines(rng, failures);
+    checkPatternFiles(failures);
+    checkRejects(failures);
+    checkSeries(failures);
+    checkLimits(failures);
+    checkAllocations(failures);
+
+    std::cout << opts.cases << " cases (" << skipped << " skipped), seed " << opts.seed << ": "
+              << (failures.count ? std::to_string(failures.count) + " failures" : std::string("ok")) << "\n";
+    return failures.count ? 1 : 0;
+}
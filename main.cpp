@@ -1,92 +1,716 @@
+#include <charconv>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "Parser.h"
-#include "Nodes.h"
+#include "Pattern.h"
+#include "PatternFile.h"
+#include "PatternSet.h"
+#include "Search.h"
+#include "Input.h"
+#include "Output.h"
+#include "Parallel.h"
 
 /**
- * A small helper that tries to find a match of the given AST anywhere in the input string.
- * If found, returns the position and sets up the captures in the context.
- * If not found, returns npos.
+ * Command-line options:
+ *   match [--all] [--lines] [--delim=C] [--threads=N] [--max-steps=N]
+ *         [--timeout-ms=N] [--stats] [--] "PATTERN" [FILE...]
+ *   match --patterns=RULES [--lines] [--delim=C] [...] [--] [FILE...]
+ *   match --patterns=RULES --compile=OUT
+ *   match --explain "PATTERN" | --explain --patterns=RULES
+ *
+ *  - --all: print every non-overlapping match (its output group), one per
+ *    line, instead of only the first one.
+ *  - --lines: treat the input as newline-separated records and print every
+ *    record that matches (or group N of its match, for \O{N} with N > 0).
+ *  - --delim=C: same, with C as the record delimiter (\n, \t, \r and \0
+ *    may be written as escapes).
+ *  - --threads=N: search files (and stdin redirected from a file) with N
+ *    threads, 0 = one per core. Pipes are always searched on one thread.
+ *  - --max-steps=N, --timeout-ms=N: give up on a search after N steps of
+ *    the matcher (bytes scanned by the automata count too, see Budget.h)
+ *    or N milliseconds (per search: per record with --lines, per match
+ *    with --all) and exit with kExitLimit.
+ *  - --patterns=RULES: match every pattern in the file RULES (one per line,
+ *    blank lines skipped) at once, see PatternSet.h. Prints the line numbers
+ *    of the patterns that match the input, one per line; with --lines, every
+ *    record that some pattern matches, as "N,M<TAB>record". No --all.
+ *    RULES may also be a file written by --compile.
+ *  - --compile=OUT: write the compiled RULES to OUT (see PatternFile.h)
+ *    instead of searching, so later runs can skip compiling them.
+ *  - --stats: print the match statistics (see Stats.h) of all searches to
+ *    stderr at the end; only in a build with -DSIMPLEPARSER_STATS=1.
+ *  - --explain: print how the pattern (or every rule) would be searched
+ *    (its MatchPlan, see Plan.h) instead of searching.
  */
-static size_t findMatch(const std::shared_ptr<ASTNode>& ast, const std::string& text,
-                        std::vector<std::optional<CaptureGroup>>& captures)
-{
-    //  search: try from each position in text
-    for (size_t start=0; start <= text.size(); ++start) {
-        MatchContext ctx { text, start, captures, false };
-        // group 0 is entire match
-        ctx.captures.resize(1, std::nullopt);
-
-        size_t savedPos = ctx.position;
-        if (ast->match(ctx)) {
-            // success
-            // store entire match as capture group 0
-            if (!ctx.captures[0].has_value()) {
-                ctx.captures[0] = CaptureGroup{savedPos, ctx.position, true};
+struct Options {
+    bool all = false;
+    bool records = false;
+    bool stats = false;
+    bool explain = false;
+    char delimiter = '\n';
+    unsigned threads = 1;
+    MatchLimits limits;
+    std::string patternFile;
+    std::string compileTo;
+    std::string pattern;
+    std::vector<std::string> files;
+};
+
+// Exit code when a search ran over its limits (EXIT_FAILURE means no match).
+static const int kExitLimit = 2;
+
+// Records matched per CompiledPattern::matchesBatch() call in record mode.
+static const size_t kBatchRecords = 1024;
+
+// What the searches over the input came to.
+struct Outcome {
+    bool found = false;
+    bool aborted = false; // some search ran over the limits
+    MatchStats stats;     // of all the searches, for --stats
+};
+
+static bool parseDelimiter(const std::string& text, char& delim)
+{
+    if (text.size() == 1) {
+        delim = text[0];
+        return true;
+    }
+    if (text.size() == 2 && text[0] == '\\') {
+        switch (text[1]) {
+        case 'n': delim = '\n'; return true;
+        case 't': delim = '\t'; return true;
+        case 'r': delim = '\r'; return true;
+        case '0': delim = '\0'; return true;
+        case '\\': delim = '\\'; return true;
+        }
+    }
+    return false;
+}
+
+// A decimal number of at most maxDigits digits.
+static bool parseNumber(const std::string& text, size_t maxDigits, uint64_t& value)
+{
+    if (text.empty() || text.size() > maxDigits ||
+        text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::stoull(text);
+    return true;
+}
+
+static bool parseArgs(int argc, char* argv[], Options& opts)
+{
+    int i = 1;
+    for (; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--") {
+            i++;
+            break;
+        }
+        if (arg.size() < 2 || arg.compare(0, 2, "--") != 0) break;
+
+        if (arg == "--all") {
+            opts.all = true;
+        } else if (arg == "--lines") {
+            opts.records = true;
+        } else if (arg.compare(0, 8, "--delim=") == 0) {
+            if (!parseDelimiter(arg.substr(8), opts.delimiter)) {
+                std::cerr << "match: bad delimiter '" << arg.substr(8) << "'\n";
+                return false;
+            }
+            opts.records = true;
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            uint64_t count;
+            if (!parseNumber(arg.substr(10), 4, count)) {
+                std::cerr << "match: bad thread count '" << arg.substr(10) << "'\n";
+                return false;
+            }
+            opts.threads = (unsigned)count;
+        } else if (arg.compare(0, 12, "--max-steps=") == 0) {
+            if (!parseNumber(arg.substr(12), 18, opts.limits.maxSteps)) {
+                std::cerr << "match: bad step limit '" << arg.substr(12) << "'\n";
+                return false;
+            }
+        } else if (arg.compare(0, 13, "--timeout-ms=") == 0) {
+            uint64_t ms;
+            if (!parseNumber(arg.substr(13), 9, ms)) {
+                std::cerr << "match: bad timeout '" << arg.substr(13) << "'\n";
+                return false;
+            }
+            opts.limits.timeout = std::chrono::milliseconds(ms);
+        } else if (arg == "--stats") {
+            if (!SIMPLEPARSER_STATS) {
+                std::cerr << "match: --stats needs a build with -DSIMPLEPARSER_STATS=1\n";
+                return false;
             }
-            captures = ctx.captures;
-            return savedPos;
+            opts.stats = true;
+        } else if (arg == "--explain") {
+            opts.explain = true;
+        } else if (arg.compare(0, 11, "--patterns=") == 0 && arg.size() > 11) {
+            opts.patternFile = arg.substr(11);
+        } else if (arg.compare(0, 10, "--compile=") == 0 && arg.size() > 10) {
+            opts.compileTo = arg.substr(10);
+        } else {
+            std::cerr << "match: unknown option " << arg << "\n";
+            return false;
         }
     }
-    return std::string::npos;
+    if (!opts.patternFile.empty()) {
+        if (opts.all) {
+            std::cerr << "match: --all can't be combined with --patterns\n";
+            return false;
+        }
+        if (!opts.compileTo.empty() || opts.explain) return true;
+    } else if (!opts.compileTo.empty()) {
+        std::cerr << "match: --compile needs --patterns\n";
+        return false;
+    } else if (i >= argc) {
+        return false;
+    } else {
+        opts.pattern = argv[i++];
+    }
+    for (; i < argc; i++) {
+        opts.files.push_back(argv[i]);
+    }
+    return true;
 }
 
-int main(int argc, char* argv[])
+/**
+ * Write group g of the last match in text, followed by delim, as a view of
+ * text (nothing is copied but into the output buffer). If that group isn't
+ * found or is out of range, nothing is printed, but the match still counts
+ * as successful.
+ */
+template <class Sink>
+static void writeGroup(Sink& out, std::string_view text, const MatchScratch& scratch, int g,
+                       char delim)
 {
-    // 1) Read pattern from command-line
-    // 2) Read input text from stdin
-    // If a match is found, print the entire match or the requested group.
-    // If no match, exit with code EXIT_FAILURE (no output).
+    const auto& captures = scratch.captures();
+    if (g >= (int)captures.size() || !captures[g].has_value()) {
+        return;
+    }
+    out.append(text.substr(captures[g]->startIndex, captures[g]->endIndex - captures[g]->startIndex));
+    out.put(delim);
+}
 
-    if (argc < 2) {
-        std::cerr << "Usage: match \"PATTERN\" < input.txt\n";
-        return EXIT_FAILURE;
+/**
+ * Search a whole in-memory input (e.g. a mapped file) and print the match.
+ */
+static void searchBuffer(const CompiledPattern& pattern, std::string_view input,
+                         const Options& opts, OutputBuffer& out, Outcome& result)
+{
+    MatchScratch scratch;
+    scratch.setLimits(opts.limits);
+    if (opts.all) {
+        // each search resumes where the last match ended; not split up
+        // between threads, as where a match starts depends on the one before
+        MatchIterator it(pattern, input, scratch);
+        while (it.next()) {
+            result.found = true;
+            writeGroup(out, input, scratch, pattern.outputGroup(), '\n');
+        }
+    } else if (findMatchParallel(pattern, input, scratch, opts.threads) != std::string_view::npos) {
+        result.found = true;
+        writeGroup(out, input, scratch, pattern.outputGroup(), '\n');
     }
+    result.aborted = result.aborted || scratch.aborted();
+    result.stats.add(scratch.stats());
+}
 
-    std::string pattern = argv[1];
+// Same for a pipe, read chunk by chunk.
+static void searchStream(const CompiledPattern& pattern, ChunkReader& reader, const Options& opts,
+                         OutputBuffer& out, Outcome& result)
+{
+    MatchScratch scratch;
+    scratch.setLimits(opts.limits);
+    if (opts.all) {
+        size_t from = 0;
+        while (findMatchInStream(pattern, reader, scratch, from)) {
+            result.found = true;
+            writeGroup(out, reader.view(), scratch, pattern.outputGroup(), '\n');
+            const CaptureGroup& whole = *scratch.captures()[0];
+            from = whole.endIndex > whole.startIndex ? whole.endIndex : whole.startIndex + 1;
+        }
+    } else if (findMatchInStream(pattern, reader, scratch)) {
+        result.found = true;
+        writeGroup(out, reader.view(), scratch, pattern.outputGroup(), '\n');
+    }
+    result.aborted = result.aborted || scratch.aborted();
+    result.stats.add(scratch.stats());
+}
 
-    // Read from stdin into a single string
-    std::ostringstream buf;
-    buf << std::cin.rdbuf();
-    std::string input = buf.str();
+// Collects the output of one chunk in memory (parallel record mode).
+struct ChunkOutput {
+    std::string text;
+    void append(std::string_view s) { text.append(s); }
+    void put(char c) { text.push_back(c); }
+    void number(uint64_t n) {
+        char digits[20];
+        text.append(digits, std::to_chars(digits, digits + sizeof digits, n).ptr);
+    }
+};
 
-    // parse the pattern
-    int outputGroup = 0; // default: group 0 = entire match
-    auto ast = parsePattern(pattern, outputGroup);
-    if (!ast) {
-        // parse failure, we produce no output, exit failure
-        return EXIT_FAILURE;
+/**
+ * Calls handle(record) for every complete record in data (plus the
+ * unterminated last one when data ends the input). Returns the offset just
+ * past the last record handled.
+ */
+template <class Handle>
+static size_t forEachRecord(std::string_view data, bool atEnd, char delim, const Handle& handle)
+{
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const char* hit = (const char*)std::memchr(data.data() + pos, delim, data.size() - pos);
+        if (!hit && !atEnd) break;
+        size_t end = hit ? (size_t)(hit - data.data()) : data.size();
+        handle(data.substr(pos, end - pos));
+        pos = hit ? end + 1 : end;
     }
+    return pos;
+}
 
-    // attempt to find a match
-    std::vector<std::optional<CaptureGroup>> captures;
-    size_t pos = findMatch(ast, input, captures);
+/**
+ * Record mode: runs the pattern on every record (see forEachRecord()) and
+ * writes out the ones that match to out (an OutputBuffer or a ChunkOutput);
+ * with --all, every match in each record instead. A record whose search
+ * runs over the limits is skipped. Without --all and \O{N} the records go
+ * through matchesBatch() kBatchRecords at a time.
+ */
+template <class Sink>
+static size_t scanRecords(const CompiledPattern& pattern, std::string_view data, bool atEnd,
+                          const Options& opts, MatchScratch& scratch, Sink& out, Outcome& result)
+{
+    int outputGroup = pattern.outputGroup();
+    char delim = opts.delimiter;
+    if (outputGroup == 0 && !opts.all) {
+        // the whole record is printed, so only a yes/no answer is needed:
+        // records are matched a batch at a time
+        RecordBatch batch;
+        batch.data = data;
+        std::vector<char> matched;
+        auto flush = [&]() {
+            bool aborted = false;
+            if (pattern.matchesBatch(batch, scratch, matched, &aborted) > 0) result.found = true;
+            result.aborted = result.aborted || aborted;
+            for (size_t k = 0; k < batch.size(); k++) {
+                if (!matched[k]) continue;
+                out.append(batch.record(k));
+                out.put(delim);
+            }
+            batch.clear();
+        };
+        size_t done = forEachRecord(data, atEnd, delim, [&](std::string_view record) {
+            batch.add(record.data() - data.data(), record.size());
+            if (batch.size() == kBatchRecords) flush();
+        });
+        flush();
+        return done;
+    }
+    return forEachRecord(data, atEnd, delim, [&](std::string_view record) {
+        if (opts.all) {
+            MatchIterator it(pattern, record, scratch);
+            while (it.next()) {
+                result.found = true;
+                writeGroup(out, record, scratch, outputGroup, delim);
+            }
+        } else if (pattern.find(record, scratch)) {
+            result.found = true;
+            writeGroup(out, record, scratch, outputGroup, delim);
+        }
+        result.aborted = result.aborted || scratch.aborted();
+    });
+}
 
-    if (pos == std::string::npos) {
-        // no match
-        return EXIT_FAILURE; // no output
+/**
+ * With several threads the input is cut right after a delimiter roughly
+ * every chunkSizeFor() bytes; each chunk is handed to
+ * scan(part, scratch, sink, outcome) on its own and the outputs are
+ * written in input order.
+ */
+template <class Scan>
+static void recordsBuffer(std::string_view input, const Options& opts, OutputBuffer& out,
+                          Outcome& result, const Scan& scan)
+{
+    char delim = opts.delimiter;
+    unsigned threads = opts.threads;
+    size_t chunk = chunkSizeFor(input.size(), threads);
+    if (workerCount(threads) <= 1 || input.size() <= chunk) {
+        MatchScratch scratch;
+        scratch.setLimits(opts.limits);
+        scan(input, scratch, out, result);
+        result.stats.add(scratch.stats());
+        return;
+    }
+
+    std::vector<size_t> bounds { 0 };
+    while (input.size() - bounds.back() > chunk) {
+        size_t pos = bounds.back() + chunk;
+        const char* hit = (const char*)std::memchr(input.data() + pos, delim, input.size() - pos);
+        if (!hit) break;
+        bounds.push_back(hit - input.data() + 1);
     }
+    bounds.push_back(input.size());
 
-    // we have a match. By default or if \O{0} is used, we print the entire match.
-    // if the user gave \O{N}, we attempt to print group N if it exists.
-    // then exit success
-    if (outputGroup >= (int)captures.size() || !captures[outputGroup].has_value()) {
-        // if that group isn't found or index out of range, we do nothing
-        // but we consider the match successful => exit success with no output
-        // (the assignment states if a match is found we DO produce output. 
-        
+    size_t count = bounds.size() - 1;
+    std::vector<ChunkOutput> outputs(count);
+    std::vector<Outcome> results(count);
+    runChunks(count, threads, [&](size_t i, MatchScratch& scratch) {
+        std::string_view part = input.substr(bounds[i], bounds[i + 1] - bounds[i]);
+        scratch.resetStats();
+        scan(part, scratch, outputs[i], results[i]);
+        results[i].stats.add(scratch.stats());
+    }, [&](size_t i) {
+        out.append(outputs[i].text);
+        std::string().swap(outputs[i].text);
+        result.found = result.found || results[i].found;
+        result.aborted = result.aborted || results[i].aborted;
+        result.stats.add(results[i].stats);
+    }, opts.limits);
+}
+
+// An incomplete last record is carried over to the next chunk.
+static void recordsStream(const CompiledPattern& pattern, ChunkReader& reader, const Options& opts,
+                          OutputBuffer& out, Outcome& result)
+{
+    MatchScratch scratch;
+    scratch.setLimits(opts.limits);
+    size_t done = 0;
+    bool more = true;
+    while (more) {
+        more = reader.refill(done);
+        done = scanRecords(pattern, reader.view(), !more, opts, scratch, out, result);
+    }
+    result.stats.add(scratch.stats());
+}
+
+// The patterns of --patterns, with the line each one came from.
+struct Rules {
+    std::shared_ptr<const PatternSet> set;
+    std::vector<size_t> lines;
+};
+
+/**
+ * Reads RULES: a compiled pattern file (from --compile) as it is, a text
+ * file by compiling every non-blank line. With --compile the compiled
+ * patterns are written out as well.
+ */
+static bool loadRules(const Options& opts, Rules& rules)
+{
+    const std::string& path = opts.patternFile;
+    MappedFile file(path);
+    if (!file.ok()) {
+        std::cerr << "match: cannot read " << path << "\n";
+        return false;
+    }
+
+    std::vector<SavedPattern> saved;    // tag = line in the text file
+    if (isPatternFile(file.view())) {
+        std::string error;
+        if (!deserializePatterns(file.view(), saved, &error)) {
+            std::cerr << "match: " << path << ": " << error << "\n";
+            return false;
+        }
+    } else {
+        bool failed = false;
+        size_t line = 0;
+        forEachRecord(file.view(), true, '\n', [&](std::string_view text) {
+            line++;
+            if (!text.empty() && text.back() == '\r') text.remove_suffix(1);
+            if (text.empty() || failed) return;
+            ParseError error;
+            auto pattern = compilePattern(std::string(text), &error);
+            if (!pattern) {
+                std::cerr << "match: bad pattern on line " << line << " of " << path << ": "
+                          << error.message << " at offset " << error.position << "\n";
+                failed = true;
+            }
+            saved.push_back(SavedPattern{pattern, line});
+        });
+        if (failed) return false;
+    }
+
+    if (!opts.compileTo.empty() && !savePatterns(opts.compileTo, saved)) {
+        std::cerr << "match: cannot write " << opts.compileTo << "\n";
+        return false;
+    }
+    std::vector<std::shared_ptr<const CompiledPattern>> patterns;
+    for (const SavedPattern& p : saved) {
+        patterns.push_back(p.pattern);
+        rules.lines.push_back(p.tag);
+    }
+    rules.set = std::make_shared<const PatternSet>(std::move(patterns));
+    return true;
+}
+
+// "N,M,...": the line numbers of the matched patterns.
+template <class Sink>
+static void writeRuleLines(Sink& out, const Rules& rules, const std::vector<size_t>& ids)
+{
+    for (size_t k = 0; k < ids.size(); k++) {
+        if (k > 0) out.put(',');
+        out.number(rules.lines[ids[k]]);
+    }
+}
+
+// Pattern-set mode on a whole input: the line of every matching pattern.
+static void rulesBuffer(const Rules& rules, std::string_view input, const Options& opts,
+                        OutputBuffer& out, Outcome& result)
+{
+    PatternSetScratch scratch;
+    scratch.setLimits(opts.limits);
+    std::vector<size_t> ids;
+    rules.set->matchAll(input, scratch, ids);
+    for (size_t id : ids) {
+        out.number(rules.lines[id]);
+        out.put('\n');
+    }
+    result.found = result.found || !ids.empty();
+    result.aborted = result.aborted || scratch.aborted();
+    result.stats.add(scratch.stats());
+}
+
+// Pattern-set record mode: "N,M<TAB>record" for every record some pattern matches.
+template <class Sink>
+static size_t scanRuleRecords(const Rules& rules, std::string_view data, bool atEnd,
+                              const Options& opts, PatternSetScratch& scratch, Sink& out,
+                              Outcome& result)
+{
+    std::vector<size_t> ids;
+    return forEachRecord(data, atEnd, opts.delimiter, [&](std::string_view record) {
+        rules.set->matchAll(record, scratch, ids);
+        result.aborted = result.aborted || scratch.aborted();
+        if (ids.empty()) return;
+        result.found = true;
+        writeRuleLines(out, rules, ids);
+        out.put('\t');
+        out.append(record);
+        out.put(opts.delimiter);
+    });
+}
+
+static void ruleRecordsStream(const Rules& rules, ChunkReader& reader, const Options& opts,
+                              OutputBuffer& out, Outcome& result)
+{
+    PatternSetScratch scratch;
+    scratch.setLimits(opts.limits);
+    size_t done = 0;
+    bool more = true;
+    while (more) {
+        more = reader.refill(done);
+        done = scanRuleRecords(rules, reader.view(), !more, opts, scratch, out, result);
+    }
+    result.stats.add(scratch.stats());
+}
+
+static int exitCode(const Outcome& result)
+{
+    if (result.aborted) return kExitLimit;
+    return result.found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// "N (P%)": part as a share of whole.
+static std::string share(uint64_t part, uint64_t whole)
+{
+    std::ostringstream text;
+    text << part;
+    if (whole > 0) text << " (" << std::fixed << std::setprecision(1) << 100.0 * part / whole << "%)";
+    return text.str();
+}
+
+// "engine, scan" of the plan, e.g. "dfa+tree, bit-parallel scan" or "dfa, reverse suffix scan".
+static std::string planSummary(const CompiledPattern& pattern)
+{
+    const MatchPlan& plan = pattern.plan();
+    std::string text = engineName(plan.engine);
+    if (plan.engine == MatchEngine::Literal) return text;
+    if (plan.reverseSuffix) {
+        text += ", reverse suffix scan";
+    } else {
+        text += plan.bitScan ? ", bit-parallel scan" : ", DFA scan";
+    }
+    return text;
+}
+
+static std::string quoted(const Literal& lit)
+{
+    if (lit.text.empty()) return "none";
+    return "\"" + lit.text + "\"" + (lit.foldCase ? " (ignoring case)" : "");
+}
+
+// The --explain report of one pattern, on stdout.
+static void explainPattern(const CompiledPattern& pattern, const char* indent)
+{
+    auto line = [&](const char* name, const std::string& value) {
+        std::cout << indent << std::left << std::setw(12) << name << value << "\n";
+    };
+    const MatchPlan& plan = pattern.plan();
+    line("pattern", pattern.source());
+    line("engine", engineName(plan.engine));
+    if (plan.engine == MatchEngine::Literal) {
+        line("literal", quoted(plan.literal));
+    } else {
+        const ShiftAnd* bits = pattern.shiftAnd();
+        line("scan", bits ? "bit-parallel, " + std::to_string(bits->positions()) + " positions"
+                          : std::string("lazy DFA"));
+        line("required", plan.requiredLiteral ? quoted(pattern.required()) : "none");
+        line("prefix", plan.prefix ? quoted(pattern.prefix()) : "none");
+        line("suffix", plan.reverseSuffix ? quoted(pattern.suffix()) + ", ends found backwards from it" : "none");
+    }
+    line("groups", std::to_string(pattern.groupCount()) + ", output " + std::to_string(pattern.outputGroup()));
+}
+
+// The --stats report, on stderr; pattern is null for --patterns.
+static void printStats(const MatchStats& stats, const CompiledPattern* pattern)
+{
+    auto line = [](const char* name, const std::string& value) {
+        std::cerr << "  " << std::left << std::setw(18) << name << value << "\n";
+    };
+    std::cerr << "match statistics:\n";
+    if (pattern) line("plan", planSummary(*pattern));
+    line("searches", std::to_string(stats.searches));
+    line("literal rejects", share(stats.literalRejects, stats.searches));
+    line("prefix scans", std::to_string(stats.prefixScans));
+    line("suffix scans", std::to_string(stats.suffixScans));
+    line("candidates", std::to_string(stats.candidates));
+    line("anchored rejects", share(stats.anchoredRejects, stats.candidates));
+    line("tree runs", std::to_string(stats.treeRuns));
+    line("matches", std::to_string(stats.matches));
+    line("DFA bytes", std::to_string(stats.dfaBytes));
+    line("backtracks", std::to_string(stats.backtracks));
+    line("memo hits", std::to_string(stats.memoHits));
+    std::ostringstream ms;
+    ms << std::fixed << std::setprecision(3) << stats.time.count() / 1e6 << " ms";
+    line("search time", ms.str());
+    bool header = false;
+    for (int k = 0; k < kNodeKinds; k++) {
+        if (stats.nodeCalls[k] == 0) continue;
+        if (!header) std::cerr << "  node calls:\n";
+        header = true;
+        std::cerr << "    " << std::left << std::setw(16) << nodeKindName((NodeKind)k)
+                  << stats.nodeCalls[k] << "\n";
+    }
+}
+
+// The exit code, after the --stats report.
+static int finish(const Options& opts, const Outcome& result, const CompiledPattern* pattern)
+{
+    if (opts.stats) printStats(result.stats, pattern);
+    return exitCode(result);
+}
+
+int main(int argc, char* argv[])
+{
+    // 1) Read options and pattern from command-line
+    // 2) Read input text from the given files, or from stdin
+    // If a match is found, print the entire match or the requested group
+    // (in record mode: for every matching record).
+    // If no match, exit with code EXIT_FAILURE (no output).
+    // If a search ran over --max-steps / --timeout-ms, exit with kExitLimit.
+
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::cerr << "Usage: match [--all] [--lines] [--delim=C] [--threads=N] [--max-steps=N] "
+                     "[--timeout-ms=N] [--stats] \"PATTERN\" [FILE...] < input.txt\n"
+                     "       match --patterns=RULES [--lines] [--delim=C] [--threads=N] ... [FILE...]\n"
+                     "       match --patterns=RULES --compile=OUT\n"
+                     "       match --explain \"PATTERN\" | --explain --patterns=RULES\n";
+        return EXIT_FAILURE;
+    }
+
+    // parse and compile the pattern (or all of them)
+    Rules rules;
+    std::shared_ptr<const CompiledPattern> compiled;
+    if (!opts.patternFile.empty()) {
+        if (!loadRules(opts, rules)) return EXIT_FAILURE;
+        if (!opts.compileTo.empty()) return EXIT_SUCCESS;
+    } else {
+        ParseError error;
+        compiled = compilePattern(opts.pattern, &error);
+        if (!compiled) {
+            // parse failure, we produce no output, exit failure
+            std::cerr << "match: bad pattern: " << error.message << " at offset " << error.position << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (opts.explain) {
+        if (compiled) explainPattern(*compiled, "");
+        for (size_t i = 0; rules.set && i < rules.set->size(); i++) {
+            std::cout << "line " << rules.lines[i] << ":\n";
+            explainPattern(rules.set->pattern(i), "  ");
+        }
         return EXIT_SUCCESS;
     }
 
-    CaptureGroup cg = captures[outputGroup].value();
-    size_t length = cg.endIndex - cg.startIndex;
-    std::string matched = input.substr(cg.startIndex, length);
+    // Many lines of output are written by a thread of their own while matching
+    // goes on, and pipes are read ahead (below), if there is a core to spare.
+    bool overlap = workerCount(0) > 1;
+    OutputBuffer out(1, 64 * 1024, overlap && (opts.all || opts.records || rules.set));
+    Outcome result;
+    auto searchInput = [&](std::string_view input) {
+        if (rules.set && opts.records) {
+            recordsBuffer(input, opts, out, result,
+                          [&](std::string_view part, MatchScratch&, auto& sink, Outcome& outcome) {
+                // one set scratch per worker thread, kept across its chunks
+                thread_local PatternSetScratch scratch;
+                scratch.setLimits(opts.limits);
+                scratch.resetStats();
+                scanRuleRecords(rules, part, true, opts, scratch, sink, outcome);
+                outcome.stats.add(scratch.stats());
+            });
+        } else if (rules.set) {
+            rulesBuffer(rules, input, opts, out, result);
+        } else if (opts.records) {
+            recordsBuffer(input, opts, out, result,
+                          [&](std::string_view part, MatchScratch& scratch, auto& sink, Outcome& outcome) {
+                scanRecords(*compiled, part, true, opts, scratch, sink, outcome);
+            });
+        } else {
+            searchBuffer(*compiled, input, opts, out, result);
+        }
+    };
 
-    // Print the matched substring from the requested group
-    std::cout << matched << std::endl;
+    // Files are mapped and searched in place, each one on its own.
+    if (!opts.files.empty()) {
+        for (const auto& path : opts.files) {
+            MappedFile file(path);
+            if (!file.ok()) {
+                std::cerr << "match: cannot read " << path << "\n";
+                continue;
+            }
+            searchInput(file.view());
+        }
+        return finish(opts, result, compiled.get());
+    }
+
+    // stdin redirected from a file can be mapped as well
+    if (MappedFile::isRegularFile(0)) {
+        MappedFile file(0);
+        if (file.ok()) {
+            searchInput(file.view());
+            return finish(opts, result, compiled.get());
+        }
+    }
+
+    // Anything else (a pipe) is read chunk by chunk, up to two chunks ahead of the matcher.
+    ChunkReader reader(0, 64 * 1024, overlap ? 2 : 0);
+    if (rules.set && opts.records) {
+        ruleRecordsStream(rules, reader, opts, out, result);
+    } else if (rules.set) {
+        // any pattern may match anywhere, so the whole input is needed
+        while (reader.refill(0)) {}
+        rulesBuffer(rules, reader.view(), opts, out, result);
+    } else if (opts.records) {
+        recordsStream(*compiled, reader, opts, out, result);
+    } else {
+        searchStream(*compiled, reader, opts, out, result);
+    }
 
-    // Return success
-    return EXIT_SUCCESS;
+    // no match: exit failure, no output
+    return finish(opts, result, compiled.get());
 }